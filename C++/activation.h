@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cmath>
+#include <type_traits>
+
+// activators for Net::calculate. the approximations trade accuracy for speed, their max errors are
+// measured in float over [-32, 32] against the exact function. the formulas are branch free; ones that
+// only hold on [-domain(), domain()] expose the range and an unclamped(), so the activation loop
+// can clamp in a separate pass (gcc does not vectorize a select whose result is computed with further).
+namespace neuralnet
+{
+	// no activation, e.g. for the first hidden layer of a Net
+	const struct identity_t {
+		template <class T>
+		T operator()(T value) const {
+			return value;
+		}
+	} identity = {};
+
+	// exact logistic function
+	const struct sigmoid_t {
+		template <class T>
+		T operator()(T value) const {
+			return 1 / (1 + std::exp(-value));
+		}
+	} sigmoid = {};
+
+	namespace detail
+	{
+		// truncated taylor series of exp in horner form, 1 + x (1 + x / 2 (1 + x / 3 (... (1 + x / order))))
+		template <int k, int order, class T>
+		T taylor_exp(T, std::true_type) {
+			return 1;
+		}
+
+		template <int k, int order, class T>
+		T taylor_exp(T x, std::false_type) {
+			return 1 + x * (T(1) / k) * taylor_exp<k + 1, order>(x, std::integral_constant<bool, (k + 1 > order)>());
+		}
+
+		template <class T>
+		T clamp(T value, T min, T max) {
+			value = value < min ? min : value;
+			return value > max ? max : value;
+		}
+	}
+
+	// the JS fastexp3 ... fastexp9: the taylor polynomial of exp, only accurate near 0
+	template <int order, class T>
+	T fastexp(T x) {
+		static_assert(order >= 1, "fastexp needs at least the linear term");
+		return detail::taylor_exp<1, order>(x, std::false_type());
+	}
+
+	// logistic function from fastexp: exp(-x) = fastexp(-x / 16)^16 with x clamped to [-16, 16],
+	// so the polynomial only sees [-1, 1].
+	// max error: order 3: 6e-5, order 4: 4e-6, order 5 and up: 4e-7 (float rounding)
+	template <int order>
+	struct sigmoid_fastexp_t {
+		// inputs are clamped to [-domain(), domain()]
+		static constexpr double domain() {
+			return 16;
+		}
+
+		template <class T>
+		static T unclamped(T value) {
+			T e = fastexp<order>(value * T(-1.0 / 16));
+
+			e *= e;
+			e *= e;
+			e *= e;
+			e *= e;
+
+			return 1 / (1 + e);
+		}
+
+		template <class T>
+		T operator()(T value) const {
+			return unclamped(detail::clamp<T>(value, -domain(), domain()));
+		}
+	};
+
+	const sigmoid_fastexp_t<3> sigmoid_fastexp3 = {};
+	const sigmoid_fastexp_t<5> sigmoid_fastexp5 = {};
+
+	// tanh from its continued fraction truncated to a 7 / 6 degree rational, with x clamped to
+	// where the fraction reaches 1. max error: 1e-4 at the clamp, below |x| = 3 it is about 1e-6.
+	const struct tanh_rational_t {
+		static constexpr double domain() {
+			return 4.97;
+		}
+
+		template <class T>
+		static T unclamped(T x) {
+			const T x2 = x * x;
+
+			const T p = x * (135135 + x2 * (17325 + x2 * (378 + x2)));
+			const T q = 135135 + x2 * (62370 + x2 * (3150 + x2 * 28));
+
+			return p / q;
+		}
+
+		template <class T>
+		T operator()(T value) const {
+			return unclamped(detail::clamp<T>(value, -domain(), domain()));
+		}
+	} tanh_rational = {};
+
+	// logistic function as 0.5 + 0.5 tanh(x / 2) with tanh_rational.
+	// max error: 5e-5
+	const struct sigmoid_rational_t {
+		static constexpr double domain() {
+			return 2 * tanh_rational_t::domain();
+		}
+
+		template <class T>
+		static T unclamped(T value) {
+			return T(0.5) + T(0.5) * tanh_rational_t::unclamped(value * T(0.5));
+		}
+
+		template <class T>
+		T operator()(T value) const {
+			return unclamped(detail::clamp<T>(value, -domain(), domain()));
+		}
+	} sigmoid_rational = {};
+
+	// piecewise linear clamp(0.2 x + 0.5, 0, 1), as in keras.
+	// max error against the logistic function: 0.076 (at |x| = 2.5)
+	const struct hard_sigmoid_t {
+		template <class T>
+		T operator()(T value) const {
+			return detail::clamp<T>(T(0.2) * value + T(0.5), 0, 1);
+		}
+	} hard_sigmoid = {};
+
+	// exact tanh (named so it cannot clash with ::tanh under using namespace neuralnet)
+	const struct tanh_exact_t {
+		template <class T>
+		T operator()(T value) const {
+			return std::tanh(value);
+		}
+	} tanh_exact = {};
+
+	// max(x, 0), exact
+	const struct relu_t {
+		template <class T>
+		T operator()(T value) const {
+			return value > 0 ? value : T(0);
+		}
+	} relu = {};
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "metrics.h"
+#include "neuralnet.h"
+
+// the genetic algos of math_test, shared by the tests and the benchmarks
+
+// progress of the algos' evolution loops, registered on metrics before it starts
+struct AlgoMetrics
+{
+	explicit AlgoMetrics(neuralnet::Metrics &metrics) :
+		evolutions(metrics.counter("evolutions")),
+		samples(metrics.counter("samples")),
+		fitness(metrics.gauge("fitness")),
+		bestFitness(metrics.gauge("best_fitness")),
+		evolutionTime(metrics.histogram("evolution_ns"))
+	{
+	}
+
+	void add(std::size_t numSamples, float lastFitness, float maxFitness, std::chrono::steady_clock::duration elapsed) {
+		evolutions.add();
+		samples.add(numSamples);
+		fitness.set(lastFitness);
+		bestFitness.set(maxFitness);
+		evolutionTime.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+	}
+
+	neuralnet::Counter &evolutions, &samples;
+	neuralnet::Gauge &fitness, &bestFitness;
+	neuralnet::Histogram &evolutionTime;
+};
+
+// the hill climb of algo and parallel_algo: evaluate(net) -> fitness scores each evolution's net on data_size samples.
+// progress goes to metrics, if given
+template <class NetT, class Evaluate>
+NetT hill_climb(std::size_t evolutions, std::size_t data_size, Evaluate evaluate, AlgoMetrics *metrics) {
+	typedef typename NetT::WeightT Weight;
+
+	NetT net;
+
+	net.update(neuralnet::RandDistro<Weight>{-1, 1});
+
+	float bestFitness = 0;
+
+	NetT best = net;
+
+	for (std::size_t evolution = 0; evolution < evolutions; ++evolution) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		const float fitness = evaluate(net);
+
+		// make sure net == best, so that we can evolve best into net with net.update
+		if (fitness > bestFitness) {
+			best = net;
+			bestFitness = fitness;
+		} else {
+			net = best;
+		}
+
+		net.mutate(0.05, neuralnet::RandDistro<Weight>{-1, 1});
+
+		if (metrics) {
+			metrics->add(data_size, fitness, bestFitness, std::chrono::steady_clock::now() - start);
+		}
+	}
+
+	return best;
+}
+
+// an example single-threaded genetic algo
+template <
+	std::size_t depth,
+	std::size_t input_size,
+	std::size_t output_size,
+	class T,
+	class Generator,
+	class FitnessFunc>
+neuralnet::Net<float, depth, input_size, output_size>
+algo(std::size_t evolutions, std::size_t data_size, Generator generator, FitnessFunc fitnessFunc, AlgoMetrics *metrics = nullptr) {
+	typedef float Weight;
+	typedef neuralnet::Net<Weight, depth, input_size, output_size> NetT;
+
+	return hill_climb<NetT>(evolutions, data_size, [&](const NetT &net) {
+		Weight input[input_size];
+		Weight output[output_size];
+
+		float fitness = 0;
+
+		for (std::size_t i = 0; i < data_size; ++i) {
+			const T value = generator();
+
+			neuralnet::write(input, value);
+			net.calculate(input, output, neuralnet::sigmoid);
+
+			fitness += fitnessFunc(value, output);
+		}
+
+		return fitness;
+	}, metrics);
+}
+
+// algo with each evolution's samples encoded into one input matrix, evaluated in parallel chunks of batched inference.
+// generator is still called on one thread, in order. with reuse_samples every evolution is scored on the same samples
+// (drawn once), so candidates are compared on equal terms and only inference remains per evolution
+template <
+	std::size_t depth,
+	std::size_t input_size,
+	std::size_t output_size,
+	class T,
+	class Generator,
+	class FitnessFunc>
+neuralnet::Net<float, depth, input_size, output_size>
+parallel_algo(std::size_t evolutions, std::size_t data_size, Generator generator, FitnessFunc fitnessFunc, bool reuse_samples = false, AlgoMetrics *metrics = nullptr) {
+	typedef float Weight;
+	typedef neuralnet::Net<Weight, depth, input_size, output_size> NetT;
+	typedef Weight Output[output_size];
+
+	// rows per parallel chunk, a few of calculate_batch's tiles
+	const std::size_t chunk_size = 4 * NetT::batchTile;
+	const std::size_t num_chunks = (data_size + chunk_size - 1) / chunk_size;
+
+	std::vector<T> values(data_size);
+	std::vector<Weight> inputs(data_size * input_size);
+	std::vector<Weight> outputs(data_size * output_size);
+
+	// summed in chunk order, so the fitness does not depend on the thread count
+	std::vector<float> chunk_fitness(num_chunks);
+
+	bool drawn = false;
+
+	return hill_climb<NetT>(evolutions, data_size, [&](const NetT &net) {
+		if (!drawn || !reuse_samples) {
+			for (std::size_t i = 0; i < data_size; ++i) {
+				values[i] = generator();
+			}
+
+			#pragma omp parallel for schedule(static)
+			for (int i = 0; i < static_cast<int>(data_size); ++i) {
+				neuralnet::write(*reinterpret_cast<Weight (*)[input_size]>(&inputs[i * input_size]), values[i]);
+			}
+
+			drawn = true;
+		}
+
+		#pragma omp parallel for schedule(static)
+		for (int c = 0; c < static_cast<int>(num_chunks); ++c) {
+			const std::size_t begin = c * chunk_size;
+			const std::size_t end = std::min(begin + chunk_size, data_size);
+
+			net.calculate_batch(&inputs[begin * input_size], &outputs[begin * output_size], end - begin, neuralnet::sigmoid);
+
+			float fitness = 0;
+
+			for (std::size_t i = begin; i < end; ++i) {
+				fitness += fitnessFunc(values[i], *reinterpret_cast<const Output *>(&outputs[i * output_size]));
+			}
+
+			chunk_fitness[c] = fitness;
+		}
+
+		float fitness = 0;
+
+		for (const float f : chunk_fitness) {
+			fitness += f;
+		}
+
+		return fitness;
+	}, metrics);
+}
+
+// math_test's task: whether a number is divisible by 4, from its bits
+inline int math_sample() {
+	return std::rand();
+}
+
+inline float math_fitness(int value, const float (&output)[1]) {
+	const bool prediction = output[0] > 0.5f;
+	const bool answer = value % 4 == 0;
+
+	return prediction == answer ? 1.0f : 0.0f;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "neuralnet.h"
+
+// gradient training for Net with sigmoid activation and cross entropy loss against targets in [0, 1].
+// as in Net::calculate the first hidden layer is not activated.
+namespace neuralnet
+{
+	template <class NetT>
+	struct Backprop
+	{
+		typedef typename NetT::WeightT Weight;
+
+		enum Optimizer {
+			SGD,
+			Adam
+		};
+
+		// a minibatch is split into this many shards whatever the thread count, each summing its gradient
+		// into its own NetT, so the reduction needs no locks and results do not depend on the threads
+		static const std::size_t shards = 16;
+
+		Optimizer optimizer;
+		double learningRate;
+		double beta1, beta2, epsilon; // Adam only
+		std::size_t steps;
+
+		explicit Backprop(Optimizer optimizer = Adam, double learningRate = 0.01) :
+			optimizer(optimizer),
+			learningRate(learningRate),
+			beta1(0.9),
+			beta2(0.999),
+			epsilon(1e-8),
+			steps(0),
+			gradients(shards),
+			losses(shards),
+			moments(NetT::num_weights(), 0),
+			velocities(NetT::num_weights(), 0)
+		{
+		}
+
+		// one update of net from count rows of inputs (input_size() each) and targets (output_size() each),
+		// returns the mean loss of the batch before the update
+		double step(NetT &net, const Weight *inputs, const Weight *targets, std::size_t count) {
+			const std::size_t inputSize = NetT::input_size(), outputSize = NetT::output_size();
+
+			#pragma omp parallel for
+			for (int s = 0; s < static_cast<int>(shards); ++s) {
+				const std::size_t begin = count * s / shards, end = count * (s + 1) / shards;
+
+				NetT &gradient = gradients[s];
+
+				std::fill(gradient.weights(), gradient.weights() + NetT::num_weights(), Weight(0));
+
+				double loss = 0;
+
+				for (std::size_t r = begin; r < end; ++r) {
+					loss += accumulate(net, inputs + r * inputSize, targets + r * outputSize, gradient);
+				}
+
+				losses[s] = loss;
+			}
+
+			++steps;
+
+			const Weight scale = count > 0 ? Weight(1) / count : Weight(0);
+
+			const double correction1 = 1 - std::pow(beta1, static_cast<double>(steps));
+			const double correction2 = 1 - std::pow(beta2, static_cast<double>(steps));
+
+			const Weight rate = static_cast<Weight>(optimizer == Adam ? learningRate * std::sqrt(correction2) / correction1 : learningRate);
+			const Weight b1 = static_cast<Weight>(beta1), b2 = static_cast<Weight>(beta2), eps = static_cast<Weight>(epsilon);
+
+			Weight * const weights = net.weights();
+			const int numWeights = static_cast<int>(NetT::num_weights());
+
+			// each weight's sum over the shards and its update are independent of every other weight
+			#pragma omp parallel for
+			for (int i = 0; i < numWeights; ++i) {
+				Weight g = 0;
+
+				for (std::size_t s = 0; s < shards; ++s) {
+					g += gradients[s].weights()[i];
+				}
+
+				g *= scale;
+
+				if (optimizer == Adam) {
+					moments[i] = b1 * moments[i] + (1 - b1) * g;
+					velocities[i] = b2 * velocities[i] + (1 - b2) * g * g;
+
+					weights[i] -= rate * moments[i] / (std::sqrt(velocities[i]) + eps);
+				} else {
+					weights[i] -= rate * g;
+				}
+			}
+
+			double loss = 0;
+
+			for (double shardLoss : losses) {
+				loss += shardLoss;
+			}
+
+			return count > 0 ? loss / count : 0.0;
+		}
+
+		// adds the gradient of one sample's loss to gradient (laid out like net), returns the loss
+		static double accumulate(const NetT &net, const Weight *input, const Weight *target, NetT &gradient) {
+			const std::size_t depth = NetT::num_hidden_layers(), size = NetT::input_size(), outputSize = NetT::output_size();
+
+			typedef Weight InputT[size];
+
+			// forward, keeping every layer's outputs: activations[0] is the input, activations[l + 1] hidden layer l's
+			InputT activations[depth + 1];
+			Weight outputs[outputSize];
+
+			std::copy(input, input + size, activations[0]);
+
+			net.hiddenLayers[0].calculate(activations[0], activations[1], identity);
+
+			for (std::size_t l = 1; l < depth; ++l) {
+				net.hiddenLayers[l].calculate(activations[l], activations[l + 1], sigmoid);
+			}
+
+			net.outputLayer.calculate(activations[depth], outputs, sigmoid);
+
+			// backward. with sigmoid outputs and cross entropy the output delta is simply outputs - targets
+			Weight outputDeltas[outputSize];
+			InputT deltas, previous;
+
+			double loss = 0;
+
+			for (std::size_t i = 0; i < outputSize; ++i) {
+				const double y = outputs[i] < Weight(1e-7) ? 1e-7 : outputs[i] > Weight(1 - 1e-7) ? 1 - 1e-7 : outputs[i];
+
+				loss -= target[i] * std::log(y) + (1 - target[i]) * std::log(1 - y);
+
+				outputDeltas[i] = outputs[i] - target[i];
+			}
+
+			backward(net.outputLayer, gradient.outputLayer, outputDeltas, outputSize, activations[depth], deltas);
+
+			for (std::size_t l = depth; l-- > 0;) {
+				// through the activation of layer l's outputs, none for the first layer
+				if (l > 0) {
+					for (std::size_t j = 0; j < size; ++j) {
+						deltas[j] *= activations[l + 1][j] * (1 - activations[l + 1][j]);
+					}
+				}
+
+				backward(net.hiddenLayers[l], gradient.hiddenLayers[l], deltas, size, activations[l], previous);
+
+				std::copy(previous, previous + size, deltas);
+			}
+
+			return loss;
+		}
+
+	private:
+		// adds the weight and bias gradients of a layer given the deltas of its count pre activation outputs,
+		// writes the deltas of its inputs. the bias is subtracted, so its gradient is -delta
+		template <class LayerT>
+		static void backward(const LayerT &layer, LayerT &gradient, const Weight *deltas, std::size_t count, const Weight *inputs, Weight *inputDeltas) {
+			const std::size_t size = NetT::input_size();
+
+			std::fill(inputDeltas, inputDeltas + size, Weight(0));
+
+			for (std::size_t i = 0; i < count; ++i) {
+				const Weight delta = deltas[i];
+				const Weight * const weights = layer.row(i);
+				Weight * const weightGradients = gradient.row(i);
+
+				for (std::size_t j = 0; j < size; ++j) {
+					weightGradients[j] += delta * inputs[j];
+					inputDeltas[j] += delta * weights[j];
+				}
+
+				gradient.bias(i) -= delta;
+			}
+		}
+
+		std::vector<NetT> gradients;
+		std::vector<double> losses;
+		std::vector<Weight> moments, velocities;
+	};
+}
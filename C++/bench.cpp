@@ -0,0 +1,607 @@
+// micro and macro benchmarks, one result per line so runs can be compared across releases.
+// usage: bench [--csv] [--time seconds] [filter], filter runs the benchmarks whose name contains it.
+// each benchmark repeats batches of calls for at least the given time (0.2 s by default) and reports the fastest
+// batch, as JSON lines by default: {"name": ..., "unit": ..., "ns_per_op": ..., "per_second": ..., "ops": ...}
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "neuralnet.h"
+#include "algo.h"
+#include "evolution.h"
+#include "players.h"
+#include "population.h"
+#include "recurrent.h"
+
+namespace nn = neuralnet;
+namespace tb = turnbasedbattle;
+
+namespace
+{
+	struct Options
+	{
+		bool csv = false;
+		double seconds = 0.2;
+		std::string filter;
+	};
+
+	Options options;
+
+	// results are added here so the compiler cannot drop the work
+	volatile double sink;
+
+	// run(n) does n ops of unit (op, inference, game...), the best ns per op over repeated batches is reported
+	template <class Run>
+	void bench(const std::string &name, const char *unit, Run run) {
+		typedef std::chrono::steady_clock Clock;
+
+		if (name.find(options.filter) == std::string::npos) {
+			return;
+		}
+
+		std::size_t n = 1;
+		double best = 0;
+		std::size_t ops = 0;
+
+		const Clock::time_point start = Clock::now();
+
+		for (;;) {
+			const Clock::time_point begin = Clock::now();
+			const std::size_t done = run(n);
+			const double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+			ops += done;
+
+			if (done > 0 && (best == 0 || elapsed / done < best)) {
+				best = elapsed / done;
+			}
+
+			if (std::chrono::duration<double>(Clock::now() - start).count() >= options.seconds) {
+				break;
+			}
+
+			// batches of about a tenth of the time
+			if (elapsed < options.seconds / 10) {
+				n *= 2;
+			}
+		}
+
+		const double ns = best * 1e9;
+		const double perSecond = best > 0 ? 1 / best : 0;
+
+		if (options.csv) {
+			std::cout << name << ',' << unit << ',' << ns << ',' << perSecond << ',' << ops << '\n';
+		} else {
+			std::cout << "{\"name\": \"" << name << "\", \"unit\": \"" << unit << "\", \"ns_per_op\": " << ns
+				<< ", \"per_second\": " << perSecond << ", \"ops\": " << ops << "}\n";
+		}
+	}
+
+	template <class Weight, std::size_t size>
+	void fill(Weight (&values)[size]) {
+		for (auto &value : values) {
+			value = nn::RandDistro<Weight>{-1, 1}(value);
+		}
+	}
+
+	template <std::size_t size>
+	void bench_neuron() {
+		nn::Neuron<float, size> neuron;
+		float inputs[size];
+
+		neuron.update(nn::RandDistro<float>{-1, 1});
+		fill(inputs);
+
+		bench("neuron/calculate/" + std::to_string(size), "op", [&](std::size_t n) {
+			float sum = 0;
+
+			for (std::size_t i = 0; i < n; ++i) {
+				inputs[0] = static_cast<float>(i & 1);
+				sum += neuron.calculate(inputs);
+			}
+
+			sink = sink + sum;
+			return n;
+		});
+	}
+
+	template <template <class, std::size_t, std::size_t> class LayerTemplate, std::size_t size>
+	void bench_layer(const char *kind) {
+		LayerTemplate<float, size, size> layer;
+		float inputs[size], outputs[size];
+
+		layer.update(nn::RandDistro<float>{-1, 1});
+		fill(inputs);
+
+		bench(std::string(kind) + "/calculate/" + std::to_string(size), "op", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				inputs[0] = static_cast<float>(i & 1);
+				layer.calculate(inputs, outputs);
+			}
+
+			sink = sink + outputs[0];
+			return n;
+		});
+
+		bench(std::string(kind) + "/calculate_sigmoid/" + std::to_string(size), "op", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				inputs[0] = static_cast<float>(i & 1);
+				layer.calculate(inputs, outputs, nn::sigmoid);
+			}
+
+			sink = sink + outputs[0];
+			return n;
+		});
+	}
+
+	// calculate per inference, calculate_batch over 64 inputs per inference, update and mutate per net
+	template <std::size_t depth, std::size_t size, std::size_t outputSize>
+	void bench_net(const char *kind) {
+		typedef nn::Net<float, depth, size, outputSize> NetT;
+
+		static const std::size_t batch = 64;
+
+		NetT net;
+		float inputs[batch][size], outputs[batch][outputSize];
+
+		net.update(nn::RandDistro<float>{-1, 1});
+
+		for (auto &row : inputs) {
+			fill(row);
+		}
+
+		const std::string name = std::string("net/") + kind + '/';
+
+		bench(name + "calculate", "inference", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				net.calculate(inputs[i % batch], outputs[0], nn::sigmoid);
+			}
+
+			sink = sink + outputs[0][0];
+			return n;
+		});
+
+		bench(name + "calculate_batch", "inference", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				net.calculate_batch(inputs[0], outputs[0], batch, nn::sigmoid);
+			}
+
+			sink = sink + outputs[0][0];
+			return n * batch;
+		});
+
+		bench(name + "update", "op", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				net.update(nn::RandDistro<float>{-1, 1});
+			}
+
+			sink = sink + net.weights()[0];
+			return n;
+		});
+
+		bench(name + "mutate", "op", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				net.mutate(0.1, nn::RandDistro<float>{-1, 1});
+			}
+
+			sink = sink + net.weights()[0];
+			return n;
+		});
+	}
+
+	// a DynamicNet of the given layer sizes, e.g. the topology of a Net or narrower hidden layers
+	void bench_dynamic_net(const char *kind, const std::vector<std::size_t> &sizes) {
+		static const std::size_t batch = 64;
+
+		nn::DynamicNet<float> net(sizes);
+		std::vector<float> inputs(batch * net.input_size()), outputs(batch * net.output_size());
+
+		net.update(nn::RandDistro<float>{-1, 1});
+
+		for (auto &input : inputs) {
+			input = nn::RandDistro<float>{-1, 1}(input);
+		}
+
+		const std::string name = std::string("dynamicnet/") + kind + '/';
+
+		bench(name + "calculate", "inference", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				net.calculate(&inputs[i % batch * net.input_size()], outputs.data(), nn::sigmoid);
+			}
+
+			sink = sink + outputs[0];
+			return n;
+		});
+
+		bench(name + "calculate_batch", "inference", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				net.calculate_batch(inputs.data(), outputs.data(), batch, nn::sigmoid);
+			}
+
+			sink = sink + outputs[0];
+			return n * batch;
+		});
+	}
+
+	// a RecurrentNet seeing turnbasedbattle's inputs, one step of one sequence or of a batch of them
+	void bench_recurrent_net() {
+		typedef nn::RecurrentNet<float, 6, 16, tb::array_size(tb::actions)> NetT;
+
+		static const std::size_t batch = 64;
+
+		NetT net;
+		float inputs[batch][NetT::input_size()], states[batch][NetT::state_size()] = {}, outputs[batch][NetT::output_size()];
+
+		net.update(nn::RandDistro<float>{-1, 1});
+
+		for (auto &row : inputs) {
+			fill(row);
+		}
+
+		bench("recurrentnet/step", "inference", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				net.step(inputs[i % batch], states[0], outputs[0], nn::sigmoid);
+			}
+
+			sink = sink + outputs[0][0];
+			return n;
+		});
+
+		bench("recurrentnet/step_batch", "inference", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				net.step_batch(inputs[0], states[0], outputs[0], batch, nn::sigmoid);
+			}
+
+			sink = sink + outputs[0][0];
+			return n * batch;
+		});
+	}
+
+	// a DeltaPopulation of 2048 connect4 nets: an evolution's child replacing the oldest individual, and materializing one
+	void bench_delta_population() {
+		typedef nn::Net<float, 2, 64, 8> NetT;
+
+		static const std::size_t size = 2048;
+
+		NetT net;
+
+		net.update(nn::RandDistro<float>{-1, 1});
+
+		nn::DeltaPopulation<NetT> population(size, net);
+
+		std::vector<std::uint32_t> changed;
+		std::size_t next = 0;
+
+		bench("population/delta/assign_child", "op", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				const std::size_t parent = (next + size / 2) % size;
+
+				population.materialize(parent, net);
+
+				changed.clear();
+				net.mutate(0.05, nn::RandDistro<float>{-1, 1}, &changed);
+
+				population.assign(next, net, parent, changed);
+				next = (next + 1) % size;
+			}
+
+			sink = sink + population.memory();
+			return n;
+		});
+
+		bench("population/delta/materialize", "op", [&](std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				population.materialize(i % size, net);
+			}
+
+			sink = sink + net.weights()[0];
+			return n;
+		});
+	}
+
+	// random legal moves until the board is full or won, moves[i] is column or -1 for a reset
+	std::vector<int> connect4_moves(std::size_t count) {
+		std::vector<int> moves;
+		Connect4 board;
+		int color = 0, pieces = 0;
+
+		while (moves.size() < count) {
+			int x = std::rand() % 8;
+
+			while (board.height(x) == 8) {
+				x = (x + 1) % 8;
+			}
+
+			board.add(static_cast<Connect4::Cell>(color), x);
+			moves.push_back(x);
+
+			if (board.won_by(static_cast<Connect4::Cell>(color)) || ++pieces == 64) {
+				board.reset();
+				moves.push_back(-1);
+				color = 0;
+				pieces = 0;
+			} else {
+				color = 1 - color;
+			}
+		}
+
+		return moves;
+	}
+
+	void bench_connect4() {
+		const std::vector<int> moves = connect4_moves(1 << 16);
+
+		bench("connect4/add", "op", [&](std::size_t n) {
+			Connect4 board;
+			int color = 0, added = 0;
+
+			for (std::size_t i = 0; i < n; ++i) {
+				const int x = moves[i % moves.size()];
+
+				if (x < 0) {
+					board.reset();
+					color = 0;
+				} else {
+					added += board.add(static_cast<Connect4::Cell>(color), x) ? 1 : 0;
+					color = 1 - color;
+				}
+			}
+
+			sink = sink + added;
+			return n;
+		});
+
+		// every position reached by the moves
+		std::vector<Connect4> positions;
+		Connect4 board;
+		int color = 0;
+
+		for (const int x : moves) {
+			if (x < 0) {
+				board.reset();
+				color = 0;
+			} else {
+				board.add(static_cast<Connect4::Cell>(color), x);
+				positions.push_back(board);
+				color = 1 - color;
+			}
+		}
+
+		bench("connect4/won", "op", [&](std::size_t n) {
+			int won = 0;
+
+			for (std::size_t i = 0; i < n; ++i) {
+				won += positions[i % positions.size()].won() != Connect4::None ? 1 : 0;
+			}
+
+			sink = sink + won;
+			return n;
+		});
+	}
+
+	void bench_turnbasedbattle_move() {
+		std::vector<const tb::Action *> actions(1 << 16);
+
+		for (auto &action : actions) {
+			action = &tb::actions[std::rand() % tb::array_size(tb::actions)];
+		}
+
+		bench("turnbasedbattle/move", "op", [&](std::size_t n) {
+			tb::Game game;
+
+			for (std::size_t i = 0; i < n; ++i) {
+				game.move(*actions[(2 * i) % actions.size()], *actions[(2 * i + 1) % actions.size()]);
+
+				if (game.is_game_over()) {
+					game.reset();
+				}
+			}
+
+			sink = sink + game.players[0].health;
+			return n;
+		});
+	}
+
+	// Evolution::step of connect4_test, 8 candidates against 2048 contenders, 2 games each, on OpenMP or pool
+	void bench_connect4_evolution(nn::ThreadPool *pool) {
+		typedef nn::Net<float, 2, 64, 8> NetT;
+		typedef nn::Evolution<NetT> EvolutionT;
+
+		std::vector<NetT> contenders(2048);
+
+		for (auto &contender : contenders) {
+			contender.update(nn::RandDistro<float>{-1, 1});
+		}
+
+		EvolutionT evolver(contenders, 8, 1);
+
+		evolver.pointsPerOpponent = 2;
+		evolver.pool = pool;
+
+		auto evaluate = [&](const NetT &candidate, std::size_t begin, std::size_t end) {
+			const std::size_t count = end - begin;
+
+			Connect4 boards[EvolutionT::chunkSize];
+			Connect4::Cell results[EvolutionT::chunkSize];
+			int turns[EvolutionT::chunkSize];
+
+			nn::Score score{0, 0, static_cast<int>(count) * 2};
+
+			// as in connect4_test, the candidate's outputs are cached under a hash of its weights
+			const std::uint64_t tag = nn::checkpoint::checksum(candidate.weights(), NetT::num_weights() * sizeof(float));
+
+			Connect4::automate_batch(boards, count, connect4_cached_player(candidate, tag), connect4_each_player(&contenders[begin]), results, turns);
+
+			for (std::size_t i = 0; i < count; ++i) {
+				score.points += results[i] == Connect4::Red ? 1 : 0;
+			}
+
+			Connect4::automate_batch(boards, count, connect4_each_player(&contenders[begin]), connect4_cached_player(candidate, tag), results, turns);
+
+			for (std::size_t i = 0; i < count; ++i) {
+				score.points += results[i] == Connect4::Black ? 1 : 0;
+			}
+
+			return score;
+		};
+
+		auto mutate = [](NetT &candidate) {
+			candidate.mutate(0.1, nn::RandDistro<float>{-1, 1});
+		};
+
+		const int scoreToBeat = 750 * static_cast<int>(contenders.size()) * 2 / 1000;
+
+		bench(std::string("evolution/connect4/step") + (pool ? "_pool" : ""), "game", [&](std::size_t n) {
+			std::size_t games = 0;
+
+			for (std::size_t i = 0; i < n; ++i) {
+				evolver.step(mutate, evaluate, scoreToBeat);
+
+				for (const nn::Score &score : evolver.scores) {
+					games += score.games;
+				}
+			}
+
+			return games;
+		});
+	}
+
+	// Evolution::step of turnbasedbattle_test, 8 candidates against 2048 contenders, on OpenMP or pool
+	void bench_turnbasedbattle_evolution(nn::ThreadPool *pool) {
+		static const std::size_t output_size = tb::array_size(tb::actions);
+
+		typedef nn::Net<float, 1, 6, output_size> NetT;
+		typedef nn::Evolution<NetT> EvolutionT;
+
+		std::vector<NetT> contenders(2048);
+
+		for (auto &contender : contenders) {
+			contender.update(nn::RandDistro<float>{-1, 1});
+		}
+
+		EvolutionT evolver(contenders, 8, 1);
+
+		evolver.pointsPerOpponent = 1;
+		evolver.pool = pool;
+
+		auto evaluate = [&](const NetT &candidate, std::size_t begin, std::size_t end) {
+			const std::size_t count = end - begin;
+
+			tb::Game games[EvolutionT::chunkSize];
+			int turns[EvolutionT::chunkSize];
+
+			nn::Score score{0, 0, static_cast<int>(count)};
+
+			tb::Game::automate_batch(games, count, turnbasedbattle_batch_player(candidate), turnbasedbattle_each_player(&contenders[begin]), 96, turns);
+
+			for (std::size_t i = 0; i < count; ++i) {
+				score.points += games[i].did_player_win(0) ? 1 : 0;
+			}
+
+			return score;
+		};
+
+		auto mutate = [](NetT &candidate) {
+			candidate.mutate(0.05, nn::RandDistro<float>{-1, 1});
+		};
+
+		const int scoreToBeat = 618 * static_cast<int>(contenders.size()) / 1000;
+
+		bench(std::string("evolution/turnbasedbattle/step") + (pool ? "_pool" : ""), "game", [&](std::size_t n) {
+			std::size_t games = 0;
+
+			for (std::size_t i = 0; i < n; ++i) {
+				evolver.step(mutate, evaluate, scoreToBeat);
+
+				for (const nn::Score &score : evolver.scores) {
+					games += score.games;
+				}
+			}
+
+			return games;
+		});
+	}
+
+	// evolutions of math_test's algos, 10000 samples each: algo, parallel_algo and parallel_algo reusing its samples
+	void bench_math_evolution() {
+		const std::size_t samples = 10000;
+
+		bench("evolution/math/algo", "sample", [&](std::size_t n) {
+			algo<1, 32, 1, int>(n, samples, math_sample, math_fitness);
+			return n * samples;
+		});
+
+		bench("evolution/math/parallel_algo", "sample", [&](std::size_t n) {
+			parallel_algo<1, 32, 1, int>(n, samples, math_sample, math_fitness);
+			return n * samples;
+		});
+
+		bench("evolution/math/parallel_algo_reuse", "sample", [&](std::size_t n) {
+			parallel_algo<1, 32, 1, int>(n, samples, math_sample, math_fitness, true);
+			return n * samples;
+		});
+	}
+}
+
+int main(int argc, char **argv) {
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--csv") == 0) {
+			options.csv = true;
+		} else if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+			options.seconds = std::atof(argv[++i]);
+		} else {
+			options.filter = argv[i];
+		}
+	}
+
+	std::srand(1);
+	nn::seed_random(1);
+
+	if (options.csv) {
+		std::cout << "name,unit,ns_per_op,per_second,ops\n";
+	}
+
+	bench_neuron<8>();
+	bench_neuron<32>();
+	bench_neuron<64>();
+	bench_neuron<256>();
+
+	bench_layer<nn::Layer, 8>("layer");
+	bench_layer<nn::Layer, 32>("layer");
+	bench_layer<nn::Layer, 64>("layer");
+	bench_layer<nn::Layer, 256>("layer");
+
+	bench_layer<nn::MatrixLayer, 8>("matrixlayer");
+	bench_layer<nn::MatrixLayer, 32>("matrixlayer");
+	bench_layer<nn::MatrixLayer, 64>("matrixlayer");
+	bench_layer<nn::MatrixLayer, 256>("matrixlayer");
+
+	bench_net<1, 32, 1>("math");
+	bench_net<1, 6, tb::array_size(tb::actions)>("turnbasedbattle");
+	bench_net<2, 64, 8>("connect4");
+	bench_net<4, 256, 8>("deep256");
+
+	bench_dynamic_net("connect4", {64, 64, 64, 8});
+	bench_dynamic_net("connect4_narrow", {64, 32, 8});
+
+	bench_recurrent_net();
+	bench_delta_population();
+
+	bench_connect4();
+	bench_turnbasedbattle_move();
+
+	bench_math_evolution();
+
+	nn::ThreadPool pool;
+
+	bench_connect4_evolution(nullptr);
+	bench_connect4_evolution(&pool);
+	bench_turnbasedbattle_evolution(nullptr);
+	bench_turnbasedbattle_evolution(&pool);
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "random.h"
+
+namespace neuralnet
+{
+	// bounded cache of net outputs for inputs that repeat, e.g. game positions. it is not synchronized,
+	// keep one per thread. an entry is found by a 128 bit key of the inputs and the tag of the net that computed it
+	// (e.g. a hash of its weights), so a cache survives switching nets. each key maps to a set of two entries:
+	// the first keeps the entry of lowest depth (e.g. pieces on the board, so openings shared by most games stay)
+	// unless it went unused for capacity inserts, the second always takes the newest.
+	template <class Weight, std::size_t outputSize>
+	struct OutputCache
+	{
+		// capacity is rounded up to a power of two entries
+		explicit OutputCache(std::size_t capacity = 1 << 12) : hits(0), misses(0), inserts(0) {
+			std::size_t sets = 1;
+
+			while (2 * sets < capacity) {
+				sets *= 2;
+			}
+
+			entries.resize(2 * sets);
+			mask = sets - 1;
+
+			clear();
+		}
+
+		std::size_t capacity() const {
+			return entries.size();
+		}
+
+		void clear() {
+			for (Entry &entry : entries) {
+				entry.depth = empty;
+			}
+		}
+
+		// the outputs stored for (tag, key0, key1), nullptr if there are none.
+		// the pointer is valid until the next insert
+		const Weight *find(std::uint64_t tag, std::uint64_t key0, std::uint64_t key1) {
+			Entry * const set = &entries[2 * slot(tag, key0, key1)];
+
+			for (int i = 0; i < 2; ++i) {
+				Entry &entry = set[i];
+
+				if (entry.depth != empty && entry.key0 == key0 && entry.key1 == key1 && entry.tag == tag) {
+					entry.stamp = inserts;
+					++hits;
+					return entry.outputs;
+				}
+			}
+
+			++misses;
+			return nullptr;
+		}
+
+		void insert(std::uint64_t tag, std::uint64_t key0, std::uint64_t key1, std::uint32_t depth, const Weight *outputs) {
+			Entry * const set = &entries[2 * slot(tag, key0, key1)];
+
+			Entry &kept = set[0];
+
+			const bool replaceKept = kept.depth == empty || depth <= kept.depth || inserts - kept.stamp > entries.size();
+
+			if (replaceKept && kept.depth != empty && !(kept.key0 == key0 && kept.key1 == key1 && kept.tag == tag)) {
+				// the displaced entry still gets the second slot
+				set[1] = kept;
+			}
+
+			Entry &entry = replaceKept ? kept : set[1];
+
+			entry.tag = tag;
+			entry.key0 = key0;
+			entry.key1 = key1;
+			entry.depth = depth;
+			entry.stamp = ++inserts;
+
+			for (std::size_t i = 0; i < outputSize; ++i) {
+				entry.outputs[i] = outputs[i];
+			}
+		}
+
+		std::uint64_t hits, misses;
+
+	private:
+		static const std::uint32_t empty = 0xFFFFFFFFu;
+
+		struct Entry
+		{
+			std::uint64_t tag, key0, key1;
+			std::uint64_t stamp; // inserts when last stored or found
+			std::uint32_t depth; // empty if unused
+			Weight outputs[outputSize];
+		};
+
+		std::size_t slot(std::uint64_t tag, std::uint64_t key0, std::uint64_t key1) const {
+			return static_cast<std::size_t>(CounterRng::mix(key0 ^ CounterRng::mix(key1 ^ CounterRng::mix(tag)))) & mask;
+		}
+
+		std::vector<Entry> entries;
+		std::size_t mask;
+		std::uint64_t inserts;
+	};
+}
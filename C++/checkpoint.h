@@ -0,0 +1,332 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define NEURALNET_CHECKPOINT_POSIX 1
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+// versioned binary checkpoints of a net or a population of nets.
+// the file is a 128 byte header followed by the raw nets, each starting on a 64 byte boundary,
+// so a mapped file can be used in place, and optionally by caller defined extra bytes (e.g. ratings of the nets).
+// files are written to a temporary and renamed over the target.
+namespace neuralnet
+{
+	namespace checkpoint
+	{
+		const char magic[8] = {'N', 'N', 'C', 'K', 'P', 'T', '\0', '\0'};
+		const std::uint32_t version = 1;
+		const std::size_t alignment = 64;
+
+		struct Header
+		{
+			char magic[8];
+			std::uint32_t version;
+			std::uint32_t weightSize; // sizeof(Weight)
+			std::uint32_t depth, inputSize, outputSize; // topology
+			std::uint32_t netSize; // sizeof(NetT), also tells Layer and MatrixLayer nets apart
+			std::uint64_t count; // nets
+			std::uint64_t stride; // bytes from one net to the next
+			std::uint64_t checksum; // of the bytes after the header
+			std::uint64_t state[8]; // caller defined, e.g. evolution cursors
+			std::uint64_t extraSize; // bytes after the nets
+		};
+
+		static_assert(sizeof(Header) % alignment == 0, "checkpoint header must keep the nets aligned");
+
+		// 64 bit FNV-1a over 8 byte words (the tail is zero padded)
+		inline std::uint64_t checksum(const void *data, std::size_t size) {
+			const unsigned char *bytes = static_cast<const unsigned char *>(data);
+
+			std::uint64_t hash = 0xCBF29CE484222325ull;
+
+			for (std::size_t i = 0; i < size; i += 8) {
+				std::uint64_t word = 0;
+				std::memcpy(&word, bytes + i, size - i < 8 ? size - i : 8);
+
+				hash = (hash ^ word) * 0x100000001B3ull;
+			}
+
+			return hash;
+		}
+
+		template <class NetT>
+		std::size_t stride() {
+			return (sizeof(NetT) + alignment - 1) / alignment * alignment;
+		}
+
+		template <class NetT>
+		Header make_header(std::size_t count) {
+			static_assert(std::is_trivially_copyable<NetT>::value, "checkpointed nets must be trivially copyable");
+
+			Header header;
+
+			std::memset(&header, 0, sizeof(header));
+			std::memcpy(header.magic, magic, sizeof(magic));
+
+			header.version = version;
+			header.weightSize = sizeof(typename NetT::WeightT);
+			header.depth = static_cast<std::uint32_t>(NetT::num_hidden_layers());
+			header.inputSize = static_cast<std::uint32_t>(NetT::input_size());
+			header.outputSize = static_cast<std::uint32_t>(NetT::output_size());
+			header.netSize = static_cast<std::uint32_t>(sizeof(NetT));
+			header.count = count;
+			header.stride = stride<NetT>();
+
+			return header;
+		}
+
+		// whether header describes a population of NetT that fits in fileSize bytes
+		template <class NetT>
+		bool compatible(const Header &header, std::size_t fileSize) {
+			const Header expected = make_header<NetT>(0);
+
+			return
+				std::memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+				header.version == version &&
+				header.weightSize == expected.weightSize &&
+				header.depth == expected.depth &&
+				header.inputSize == expected.inputSize &&
+				header.outputSize == expected.outputSize &&
+				header.netSize == expected.netSize &&
+				header.stride == expected.stride &&
+				fileSize >= sizeof(Header) &&
+				// divided rather than multiplied, so a corrupt count cannot overflow past the check
+				header.count <= (fileSize - sizeof(Header)) / header.stride &&
+				header.extraSize <= fileSize - sizeof(Header) - header.count * header.stride;
+		}
+	}
+
+	// writes nets [nets, nets + count) to path atomically: a crash leaves either the old or the new file.
+	// state holds up to 8 caller defined values, returned in the header when loading, and the extraSize bytes
+	// at extra follow the nets in the same file
+	template <class NetT>
+	bool save_population(const std::string &path, const NetT *nets, std::size_t count, const std::uint64_t *state = nullptr, std::size_t stateSize = 0, const void *extra = nullptr, std::size_t extraSize = 0) {
+		const std::size_t stride = checkpoint::stride<NetT>();
+
+		std::vector<unsigned char> payload(count * stride + extraSize, 0);
+
+		for (std::size_t i = 0; i < count; ++i) {
+			std::memcpy(&payload[i * stride], &nets[i], sizeof(NetT));
+		}
+
+		if (extraSize > 0) {
+			std::memcpy(&payload[count * stride], extra, extraSize);
+		}
+
+		checkpoint::Header header = checkpoint::make_header<NetT>(count);
+
+		header.extraSize = extraSize;
+		header.checksum = checkpoint::checksum(payload.data(), payload.size());
+		for (std::size_t i = 0; i < stateSize && i < 8; ++i) {
+			header.state[i] = state[i];
+		}
+
+		const std::string temp = path + ".tmp";
+
+#ifdef NEURALNET_CHECKPOINT_POSIX
+		const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if (fd < 0) {
+			return false;
+		}
+
+		auto write_all = [fd](const void *data, std::size_t size) {
+			const char *bytes = static_cast<const char *>(data);
+
+			while (size > 0) {
+				const ssize_t written = ::write(fd, bytes, size);
+
+				if (written <= 0) {
+					return false;
+				}
+
+				bytes += written;
+				size -= static_cast<std::size_t>(written);
+			}
+
+			return true;
+		};
+
+		const bool ok = write_all(&header, sizeof(header)) && write_all(payload.data(), payload.size()) && ::fsync(fd) == 0;
+
+		::close(fd);
+
+		if (!ok || ::rename(temp.c_str(), path.c_str()) != 0) {
+			::unlink(temp.c_str());
+			return false;
+		}
+
+		return true;
+#else
+		std::FILE *file = std::fopen(temp.c_str(), "wb");
+
+		if (!file) {
+			return false;
+		}
+
+		const bool ok =
+			std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+			(payload.empty() || std::fwrite(payload.data(), payload.size(), 1, file) == 1);
+
+		if (std::fclose(file) != 0 || !ok) {
+			std::remove(temp.c_str());
+			return false;
+		}
+
+		// not atomic where rename does not replace an existing file
+		std::remove(path.c_str());
+
+		return std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+	}
+
+	template <class NetT>
+	bool save_net(const std::string &path, const NetT &net) {
+		return save_population(path, &net, 1);
+	}
+
+	// a checkpoint mapped read only, the nets are used in place without copying or parsing
+	template <class NetT>
+	struct MappedPopulation
+	{
+		MappedPopulation() : base(nullptr), length(0) {}
+
+		MappedPopulation(const MappedPopulation &) = delete;
+		MappedPopulation &operator=(const MappedPopulation &) = delete;
+
+		~MappedPopulation() {
+			close();
+		}
+
+		// verify reads the whole file to check the checksum, skip it for constant time loading
+		bool open(const std::string &path, bool verify = true) {
+			close();
+
+#ifdef NEURALNET_CHECKPOINT_POSIX
+			const int fd = ::open(path.c_str(), O_RDONLY);
+
+			if (fd < 0) {
+				return false;
+			}
+
+			struct stat info;
+
+			if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(checkpoint::Header)) {
+				::close(fd);
+				return false;
+			}
+
+			void *mapped = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+			::close(fd);
+
+			if (mapped == MAP_FAILED) {
+				return false;
+			}
+
+			base = static_cast<const unsigned char *>(mapped);
+			length = static_cast<std::size_t>(info.st_size);
+#else
+			std::FILE *file = std::fopen(path.c_str(), "rb");
+
+			if (!file) {
+				return false;
+			}
+
+			std::fseek(file, 0, SEEK_END);
+			const long size = std::ftell(file);
+			std::fseek(file, 0, SEEK_SET);
+
+			// uint64_t storage keeps the copy 8 byte aligned
+			buffer.resize((static_cast<std::size_t>(size > 0 ? size : 0) + 7) / 8);
+
+			const bool ok = size > 0 && std::fread(buffer.data(), static_cast<std::size_t>(size), 1, file) == 1;
+
+			std::fclose(file);
+
+			if (!ok) {
+				return false;
+			}
+
+			base = reinterpret_cast<const unsigned char *>(buffer.data());
+			length = static_cast<std::size_t>(size);
+#endif
+
+			if (!checkpoint::compatible<NetT>(header(), length) ||
+				(verify && checkpoint::checksum(base + sizeof(checkpoint::Header), header().count * header().stride + header().extraSize) != header().checksum)) {
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void close() {
+#ifdef NEURALNET_CHECKPOINT_POSIX
+			if (base) {
+				::munmap(const_cast<unsigned char *>(base), length);
+			}
+#else
+			buffer.clear();
+#endif
+			base = nullptr;
+			length = 0;
+		}
+
+		bool is_open() const {
+			return base != nullptr;
+		}
+
+		const checkpoint::Header &header() const {
+			return *reinterpret_cast<const checkpoint::Header *>(base);
+		}
+
+		std::size_t size() const {
+			return base ? static_cast<std::size_t>(header().count) : 0;
+		}
+
+		const NetT &operator[](std::size_t i) const {
+			return *reinterpret_cast<const NetT *>(base + sizeof(checkpoint::Header) + i * header().stride);
+		}
+
+		// the extra bytes saved after the nets, extra_size() of them
+		const unsigned char *extra() const {
+			return base + sizeof(checkpoint::Header) + header().count * header().stride;
+		}
+
+		std::size_t extra_size() const {
+			return base ? static_cast<std::size_t>(header().extraSize) : 0;
+		}
+
+	private:
+		const unsigned char *base;
+		std::size_t length;
+#ifndef NEURALNET_CHECKPOINT_POSIX
+		std::vector<std::uint64_t> buffer;
+#endif
+	};
+
+	template <class NetT>
+	bool load_net(const std::string &path, NetT &net) {
+		MappedPopulation<NetT> population;
+
+		if (!population.open(path) || population.size() != 1) {
+			return false;
+		}
+
+		net = population[0];
+
+		return true;
+	}
+}
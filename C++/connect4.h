@@ -1,7 +1,8 @@
 #pragma once
 
-#include <cstring>
+#include <cstdint>
 #include <iostream>
+#include <vector>
 
 struct Connect4
 {
@@ -26,53 +27,31 @@ struct Connect4
 
 	void reset() {
 		size = 0;
+		masks[Red] = masks[Black] = 0;
 
-		each([](Cell &cell) {
-			cell = Connect4::None;
-		});
-	}
-
-	template <class Func>
-	void each(Func func) {
-		for (int y = 0; y < 8; ++y) {
-			auto &cells_y = cells[y];
-			for (int x = 0; x < 8; ++x) {
-				func(cells_y[x]);
-			}
+		for (int x = 0; x < 8; ++x) {
+			heights[x] = 0;
 		}
 	}
 
+	// visits every cell row by row from the top
 	template <class Func>
 	void each(Func func) const {
 		for (int y = 0; y < 8; ++y) {
-			auto &cells_y = cells[y];
 			for (int x = 0; x < 8; ++x) {
-				func(cells_y[x]);
+				func(at(x, y));
 			}
 		}
 	}
 
 	bool add(Cell cell, int x) {
-		if (x < 0 || x > 7) {
-			return false;
-		}
-
-		int y = 0;
-
-		for (; y < 8; ++y) {
-			if (cells[y][x] != None) {
-				break;
-			}
-		}
-
-		if (y == 0) {
+		if (cell == None || x < 0 || x > 7 || heights[x] == 8) {
 			return false;
 		}
 
-		--y;
-
-		cells[y][x] = cell;
+		masks[cell] |= std::uint64_t(1) << (x * 8 + heights[x]);
 
+		++heights[x];
 		++size;
 
 		return true;
@@ -91,7 +70,7 @@ struct Connect4
 			++numTurns;
 
 			if (add(Cell::Red, actor1(const_self, Cell::Red))) {
-				if (won() == Cell::Red) {
+				if (won_by(Cell::Red)) {
 					return Cell::Red;
 				}
 			}
@@ -102,7 +81,7 @@ struct Connect4
 			++numTurns;
 
 			if (add(Cell::Black, actor2(const_self, Cell::Black))) {
-				if (won() == Cell::Black) {
+				if (won_by(Cell::Black)) {
 					return Cell::Black;
 				}
 			}
@@ -116,50 +95,82 @@ struct Connect4
 		}
 	}
 
-	Cell won() const {
-		if (size == 64) {
-			return None;
+	// plays count games in lock step, with the same rules as automate. each ply, an actor is called once
+	// with every live game: actor(boards, indices, n, color, moves) sets moves[k] for boards[indices[k]],
+	// k < n, which lets a net evaluate all live positions as one batch. games retire as they finish.
+	template <class Actor1, class Actor2>
+	static void automate_batch(Connect4 *boards, std::size_t count, Actor1 actor1, Actor2 actor2, Cell *results, int *numTurns) {
+		std::vector<std::size_t> live(count), next;
+		std::vector<int> moves(count), stalls(count);
+
+		for (std::size_t i = 0; i < count; ++i) {
+			boards[i].reset();
+			live[i] = i;
+			numTurns[i] = 0;
 		}
 
-		const Cell values[] = {Red, Black};
+		next.reserve(count);
 
-		for (std::size_t i = 0; i < 2; ++i) {
-			const Cell value = values[i];
+		const Connect4 *const_boards = boards;
 
-			for (int y = 0; y <= 4; ++y) {
-				for (int x = 0; x <= 4; ++x) {
-					if (cells[y][x] == value && cells[y + 1][x + 1] == value && cells[y + 2][x + 2] == value && cells[y + 3][x + 3] == value) {
-						return value;
-					}
-				}
+		while (!live.empty()) {
+			for (const std::size_t i : live) {
+				stalls[i] = 0;
 			}
 
-			for (int y = 3; y < 8; ++y) {
-				for (int x = 0; x <= 4; ++x) {
-					if (cells[y][x] == value && cells[y - 1][x + 1] == value && cells[y - 2][x + 2] == value && cells[y - 3][x + 3] == value) {
-						return value;
-					}
+			// both players move unless the first one wins, then a double stall is a draw
+			for (int turn = 0; turn < 2 && !live.empty(); ++turn) {
+				const Cell color = turn == 0 ? Red : Black;
+
+				if (turn == 0) {
+					actor1(const_boards, live.data(), live.size(), color, moves.data());
+				} else {
+					actor2(const_boards, live.data(), live.size(), color, moves.data());
 				}
-			}
 
-			for (int y = 0; y < 8; ++y) {
-				for (int x = 0; x <= 4; ++x) {
-					if (cells[y][x] == value && cells[y][x + 1] == value && cells[y][x + 2] == value && cells[y][x + 3] == value) {
-						return value;
+				next.clear();
+
+				for (std::size_t k = 0; k < live.size(); ++k) {
+					const std::size_t i = live[k];
+
+					++numTurns[i];
+
+					if (boards[i].add(color, moves[k])) {
+						if (boards[i].won_by(color)) {
+							results[i] = color;
+							continue;
+						}
+					} else {
+						++stalls[i];
 					}
-				}
-			}
 
-			for (int y = 0; y <= 4; ++y) {
-				for (int x = 0; x < 8; ++x) {
-					if (cells[y][x] == value && cells[y + 1][x] == value && cells[y + 2][x] == value && cells[y + 3][x] == value) {
-						return value;
+					if (turn == 1 && stalls[i] == 2) {
+						results[i] = None;
+						continue;
 					}
+
+					next.push_back(i);
 				}
+
+				live.swap(next);
 			}
 		}
+	}
 
-		return None;
+	Cell won() const {
+		if (size == 64) {
+			return None;
+		}
+
+		return
+			has_four(masks[Red]) ? Red :
+			has_four(masks[Black]) ? Black :
+			None;
+	}
+
+	// only the player who just moved can have completed a line
+	bool won_by(Cell cell) const {
+		return size != 64 && has_four(masks[cell]);
 	}
 
 	void draw() const {
@@ -171,7 +182,7 @@ struct Connect4
 
 		for (int y = 0; y < 8; ++y) {
 			for (int x = 0; x < 8; ++x) {
-				const Cell c = cells[y][x];
+				const Cell c = at(x, y);
 				std::cout << (c == Red ? 'X' : c == Black ? 'O' : '-');
 			}
 			std::cout << '\n';
@@ -179,10 +190,49 @@ struct Connect4
 	}
 
 	Cell at(int x, int y) const {
-		return cells[y][x];
+		const std::uint64_t bit = std::uint64_t(1) << (x * 8 + 7 - y);
+
+		return
+			masks[Red] & bit ? Red :
+			masks[Black] & bit ? Black :
+			None;
+	}
+
+	// bitboard of cell's pieces, bit x * 8 + h is column x at height h from the bottom
+	std::uint64_t mask(Cell cell) const {
+		return masks[cell];
+	}
+
+	int height(int x) const {
+		return heights[x];
 	}
 
 private:
-	Cell cells[8][8];
+	static bool has_four(std::uint64_t b) {
+		// the masks drop starts whose line would wrap into the next column
+		const std::uint64_t lowRows = 0x1F1F1F1F1F1F1F1Full; // heights 0-4
+		const std::uint64_t highRows = 0xF8F8F8F8F8F8F8F8ull; // heights 3-7
+
+		std::uint64_t m = b & (b >> 1); // vertical
+		if (m & (m >> 2) & lowRows) {
+			return true;
+		}
+
+		m = b & (b >> 8); // horizontal
+		if (m & (m >> 16)) {
+			return true;
+		}
+
+		m = b & (b >> 9); // diagonal up
+		if (m & (m >> 18) & lowRows) {
+			return true;
+		}
+
+		m = b & (b >> 7); // diagonal down
+		return (m & (m >> 14) & highRows) != 0;
+	}
+
+	std::uint64_t masks[2];
+	int heights[8];
 	int size;
 };
\ No newline at end of file
@@ -0,0 +1,399 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+#include "neuralnet.h"
+#include "rating.h"
+#include "threadpool.h"
+
+namespace neuralnet
+{
+	// points and turns a candidate collected in some games
+	struct Score
+	{
+		int points;
+		int turns;
+		int games;
+	};
+
+	// the hill climbing loop of the game tests, evaluating several mutants per generation.
+	// every (candidate, chunk of opponents) pair is one task of a single parallel loop, so all
+	// cores stay busy until the whole generation is done. admissions then happen in candidate order,
+	// and each candidate's mutation is seeded from (seed, candidate number), so runs replay exactly.
+	template <class NetT>
+	struct Evolution
+	{
+		// opponents per task, evaluate is never given more than this
+		static const std::size_t chunkSize = 64;
+
+		Evolution(std::vector<NetT> &contenders, std::size_t numCandidates, std::uint64_t seed) :
+			contenders(contenders),
+			candidates(numCandidates),
+			scores(numCandidates),
+			seed(seed),
+			numEvaluated(0),
+			parentIndex(0),
+			nextContenderIndex(0),
+			progress(numCandidates),
+			passed(numCandidates, 0),
+			opponentNets(contenders.data())
+		{
+		}
+
+		// mutate(NetT &candidate) changes a copy of its parent.
+		// evaluate(const NetT &candidate, std::size_t begin, std::size_t end) -> Score plays opponents() [begin, end),
+		// which are all the contenders. candidates scoring more than scoreToBeat points replace the oldest contenders.
+		// returns the number admitted.
+		template <class Mutate, class Evaluate>
+		std::size_t step(Mutate mutate, Evaluate evaluate, int scoreToBeat) {
+			opponentNets = contenders.data();
+
+			play(mutate, [&](int k, std::size_t begin, std::size_t end) {
+				return evaluate(candidates[k], begin, end);
+			}, contenders.size(), scoreToBeat, pointsPerOpponent);
+
+			std::size_t numAdmitted = 0;
+
+			for (std::size_t k = 0; k < candidates.size(); ++k) {
+				if (passed[k]) {
+					admit(candidates[k]);
+					++numAdmitted;
+				}
+			}
+
+			numEvaluated += candidates.size();
+
+			return numAdmitted;
+		}
+
+		// step against a sample of the contenders, for pools too large to play whole. needs ratings, one per contender.
+		// each candidate plays sampleSize opponents, one from each stratum of the pool sorted by rating, and is admitted
+		// (with that rating) if its performance rating over those games beats ratingToBeat. there is no early abort here:
+		// a sample cut short by a pass or fail would be rated too high or too low, and which opponents were played would
+		// depend on the thread timing, while every game goes into the ratings and so into the next sample.
+		// evaluate(const NetT &candidate, std::size_t begin, std::size_t end, int *points) -> Score plays opponents() [begin, end)
+		// and also writes the candidate's points against each of them to points[i - begin]. unless the candidate
+		// scored all or none of the points, every game then updates the rating of the opponent, counting pointsPerOpponent
+		// (at least 1) games per opponent, in candidate order. returns the number admitted.
+		template <class Mutate, class Evaluate>
+		std::size_t step_rated(Mutate mutate, Evaluate evaluate, double ratingToBeat) {
+			const std::size_t numCandidates = candidates.size();
+
+			CounterRng rng(CounterRng::mix(seed), numEvaluated);
+
+			ratings->sample(sampleSize, rng, sampleIndices);
+
+			const std::size_t numOpponents = sampleIndices.size();
+
+			sample.resize(numOpponents);
+
+			for (std::size_t i = 0; i < numOpponents; ++i) {
+				sample[i] = contenders[sampleIndices[i]];
+			}
+
+			opponentNets = sample.data();
+
+			const int gamesEach = pointsPerOpponent > 0 ? pointsPerOpponent : 1;
+
+			// a performance above ratingToBeat is the same as more points than it would be expected to score
+			double expectedPoints = 0;
+
+			for (const std::size_t i : sampleIndices) {
+				expectedPoints += gamesEach * EloRatings::expected(ratingToBeat, ratings->ratings[i]);
+			}
+
+			opponentPoints.assign(numCandidates * numOpponents, 0);
+
+			play(mutate, [&](int k, std::size_t begin, std::size_t end) {
+				return evaluate(candidates[k], begin, end, &opponentPoints[k * numOpponents + begin]);
+			}, numOpponents, static_cast<int>(std::floor(expectedPoints)), 0);
+
+			// rated in candidate order, so runs replay exactly
+			performances.resize(numCandidates);
+
+			for (std::size_t k = 0; k < numCandidates; ++k) {
+				const int *points = &opponentPoints[k * numOpponents];
+				const int total = std::accumulate(points, points + numOpponents, 0);
+
+				performances[k] = ratings->performance(sampleIndices.data(), numOpponents, gamesEach, total);
+
+				// a perfect or nil score's performance is only a cap, which the opponents' updates would not sum to zero against
+				if (total == 0 || total == gamesEach * static_cast<int>(numOpponents)) {
+					continue;
+				}
+
+				for (std::size_t i = 0; i < numOpponents; ++i) {
+					ratings->update(sampleIndices[i], gamesEach, gamesEach - points[i], performances[k]);
+				}
+			}
+
+			std::size_t numAdmitted = 0;
+
+			for (std::size_t k = 0; k < numCandidates; ++k) {
+				if (passed[k]) {
+					admit(candidates[k], performances[k]);
+					++numAdmitted;
+				}
+			}
+
+			numEvaluated += numCandidates;
+
+			return numAdmitted;
+		}
+
+		// net replaces the oldest contender, as an admitted candidate does (e.g. a migrant from another island).
+		// with ratings it starts at the mean rating
+		void admit(const NetT &net) {
+			admit(net, ratings ? ratings->mean() : 0);
+		}
+
+		// the same, starting at rating
+		void admit(const NetT &net, double rating) {
+			if (ratings) {
+				ratings->reset(nextContenderIndex, rating);
+			}
+
+			contenders[nextContenderIndex] = net;
+
+			if (++nextContenderIndex == contenders.size()) {
+				nextContenderIndex = 0;
+			}
+		}
+
+		// the nets evaluate plays during a step, all the contenders or step_rated's sample
+		const NetT *opponents() const {
+			return opponentNets;
+		}
+
+		// writes the contenders and the cursors, so a run restored from path continues exactly where this one is.
+		// the ratings, if any, are the extra bytes of the same file, so a crash cannot leave them out of step
+		bool save(const std::string &path) const {
+			const std::uint64_t state[4] = {seed, numEvaluated, parentIndex, nextContenderIndex};
+
+			std::vector<unsigned char> extra;
+
+			if (ratings) {
+				ratings->write(extra);
+			}
+
+			return save_population(path, contenders.data(), contenders.size(), state, 4, extra.data(), extra.size());
+		}
+
+		// fails, leaving everything unchanged, unless path holds as many contenders of the same net type
+		// (and with ratings, as many ratings). the file is mapped, so besides verify's checksum pass over it, the only
+		// cost growing with the population is one copy of the contenders out of the mapping
+		bool restore(const std::string &path, bool verify = true) {
+			MappedPopulation<NetT> population;
+
+			if (!population.open(path, verify) || population.size() != contenders.size()) {
+				return false;
+			}
+
+			if (ratings && !ratings->read(population.extra(), population.extra_size())) {
+				return false;
+			}
+
+			for (std::size_t i = 0; i < contenders.size(); ++i) {
+				contenders[i] = population[i];
+			}
+
+			const std::uint64_t *state = population.header().state;
+
+			seed = state[0];
+			numEvaluated = static_cast<std::size_t>(state[1]);
+			parentIndex = static_cast<std::size_t>(state[2]);
+			nextContenderIndex = static_cast<std::size_t>(state[3]);
+
+			return true;
+		}
+
+		// the most recently admitted contender
+		const NetT &best() const {
+			return contenders[(nextContenderIndex > 0 ? nextContenderIndex : contenders.size()) - 1];
+		}
+
+		// early abort: with the most points a single opponent can give, a candidate stops playing
+		// once it has passed scoreToBeat or can no longer reach it. this never changes admissions.
+		// 0 plays every game. step_rated never aborts, it only counts pointsPerOpponent games per opponent
+		int pointsPerOpponent = 0;
+
+		// with early abort, additionally stop once the points per game are stopZ standard errors
+		// above or below the rate needed to pass. assumes a game is worth at most one point.
+		// unlike the exact bounds this can change admissions, and which chunks were played first. 0 disables.
+		double stopZ = 0;
+
+		// runs step's loops when set, otherwise they are OpenMP loops
+		ThreadPool *pool = nullptr;
+
+		// of the contenders, needed by step_rated and kept up to date by admissions
+		EloRatings *ratings = nullptr;
+
+		// opponents per candidate in step_rated
+		std::size_t sampleSize = 256;
+
+		std::vector<NetT> &contenders;
+		std::vector<NetT> candidates;
+		std::vector<Score> scores; // of the last step, per candidate. aborted candidates only count the games played
+		std::uint64_t seed;
+		std::size_t numEvaluated;
+		std::size_t parentIndex;
+		std::size_t nextContenderIndex;
+
+	private:
+		// mutates the candidates and plays each against opponents [0, numOpponents), with evaluate(k, begin, end)
+		// playing candidate k. leaves scores, and passed for the candidates scoring more than scoreToBeat.
+		// pointsEach is the early abort's pointsPerOpponent, 0 plays every game
+		template <class Mutate, class Evaluate>
+		void play(Mutate mutate, Evaluate evaluate, std::size_t numOpponents, int scoreToBeat, int pointsEach) {
+			const int numCandidates = static_cast<int>(candidates.size());
+			const int numChunks = static_cast<int>((numOpponents + chunkSize - 1) / chunkSize);
+			const int maxPoints = static_cast<int>(numOpponents) * pointsEach;
+
+			for (auto &candidate : candidates) {
+				candidate = contenders[parentIndex];
+
+				if (++parentIndex == contenders.size()) {
+					parentIndex = 0;
+				}
+			}
+
+			parallel_for(numCandidates, [&](int k) {
+				seed_random(seed, numEvaluated + k);
+				mutate(candidates[k]);
+			});
+
+			// chunks are played in a random order, so an early abort judges on a representative sample
+			chunkOrder.resize(numChunks);
+			std::iota(chunkOrder.begin(), chunkOrder.end(), 0);
+
+			if (pointsEach > 0) {
+				CounterRng rng(seed, ~static_cast<std::uint64_t>(numEvaluated));
+				std::shuffle(chunkOrder.begin(), chunkOrder.end(), rng);
+			}
+
+			for (auto &p : progress) {
+				p.tally = 0;
+				p.potential = maxPoints;
+				p.verdict = 0;
+			}
+
+			partials.assign(candidates.size() * numChunks, Score{0, 0, 0});
+
+			// chunk major, so every candidate advances through its opponents at the same pace
+			parallel_for(numCandidates * numChunks, [&](int task) {
+				const int k = task % numCandidates;
+				const int chunk = chunkOrder[task / numCandidates];
+
+				Progress &p = progress[k];
+
+				if (p.verdict.load(std::memory_order_relaxed) != 0) {
+					return;
+				}
+
+				const std::size_t begin = chunk * chunkSize;
+				const std::size_t end = begin + chunkSize < numOpponents ? begin + chunkSize : numOpponents;
+
+				const Score score = evaluate(k, begin, end);
+
+				partials[k * numChunks + chunk] = score;
+
+				if (pointsEach > 0) {
+					// each total is updated by one atomic add, so no other chunk can be half counted in it
+					const std::uint64_t tally = p.tally += (static_cast<std::uint64_t>(score.games) << 32) + static_cast<std::uint64_t>(score.points);
+					const int potential = p.potential += score.points - static_cast<int>(end - begin) * pointsEach;
+
+					int undecided = 0;
+					const int verdict = judge(static_cast<int>(tally & 0xFFFFFFFFu), static_cast<int>(tally >> 32), potential, scoreToBeat, maxPoints);
+
+					if (verdict != 0) {
+						p.verdict.compare_exchange_strong(undecided, verdict);
+					}
+				}
+			});
+
+			for (int k = 0; k < numCandidates; ++k) {
+				Score &score = scores[k];
+
+				score = Score{0, 0, 0};
+
+				for (int c = 0; c < numChunks; ++c) {
+					score.points += partials[k * numChunks + c].points;
+					score.turns += partials[k * numChunks + c].turns;
+					score.games += partials[k * numChunks + c].games;
+				}
+
+				const int verdict = progress[k].verdict;
+
+				passed[k] = verdict > 0 || (verdict == 0 && score.points > scoreToBeat);
+			}
+		}
+
+		// func(i) for i in [0, count) on the pool or an OpenMP team, one index per task
+		template <class Func>
+		void parallel_for(int count, Func func) {
+			if (pool) {
+				pool->for_each(static_cast<std::size_t>(count), 1, [&](std::size_t i) {
+					func(static_cast<int>(i));
+				});
+			} else {
+				#pragma omp parallel for schedule(dynamic)
+				for (int i = 0; i < count; ++i) {
+					func(i);
+				}
+			}
+		}
+
+		struct Progress
+		{
+			std::atomic<std::uint64_t> tally; // games played in the high 32 bits, points in the low 32
+			std::atomic<int> potential; // the most points still possible, maxPoints minus the points lost so far
+			std::atomic<int> verdict; // 1 passed, -1 failed, 0 undecided
+		};
+
+		// 1 passed, -1 failed, 0 undecided
+		int judge(int points, int games, int potential, int scoreToBeat, int maxPoints) const {
+			if (points > scoreToBeat) {
+				return 1;
+			}
+
+			if (potential <= scoreToBeat) {
+				return -1;
+			}
+
+			if (stopZ > 0 && games > 0) {
+				// normal approximation of the points per game against the rate needed to pass
+				const double rate = static_cast<double>(scoreToBeat) / maxPoints;
+				const double error = std::sqrt(rate * (1 - rate) / games);
+				const double z = (static_cast<double>(points) / games - rate) / error;
+
+				if (z > stopZ) {
+					return 1;
+				}
+
+				if (z < -stopZ) {
+					return -1;
+				}
+			}
+
+			return 0;
+		}
+
+		std::vector<Progress> progress;
+		std::vector<Score> partials;
+		std::vector<int> chunkOrder;
+		std::vector<char> passed; // per candidate, of the last play
+		const NetT *opponentNets;
+		std::vector<NetT> sample;
+		std::vector<std::size_t> sampleIndices;
+		std::vector<int> opponentPoints; // candidate major
+		std::vector<double> performances;
+	};
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define NEURALNET_ISLAND_POSIX 1
+	#include <sys/mman.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+#else
+	#include <thread>
+#endif
+
+// island model evolution: each island evolves its own population in its own process and now and then
+// sends its best nets to the islands it is connected to. migrants travel through one single producer,
+// single consumer ring per connection, in memory shared by all islands, so no island ever waits for another.
+// without fork (not POSIX) the islands are threads of one process.
+namespace neuralnet
+{
+	// migration topologies, topology[i] lists the islands island i sends to
+
+	// i sends to i + 1, the last to the first
+	inline std::vector<std::vector<std::size_t>> ring_topology(std::size_t numIslands) {
+		std::vector<std::vector<std::size_t>> topology(numIslands);
+
+		for (std::size_t i = 0; i < numIslands && numIslands > 1; ++i) {
+			topology[i].push_back((i + 1) % numIslands);
+		}
+
+		return topology;
+	}
+
+	// every island sends to every other
+	inline std::vector<std::vector<std::size_t>> fully_connected_topology(std::size_t numIslands) {
+		std::vector<std::vector<std::size_t>> topology(numIslands);
+
+		for (std::size_t i = 0; i < numIslands; ++i) {
+			for (std::size_t j = 0; j < numIslands; ++j) {
+				if (i != j) {
+					topology[i].push_back(j);
+				}
+			}
+		}
+
+		return topology;
+	}
+
+	// create before run_islands, so every island sees the same shared memory
+	template <class NetT>
+	struct Migration
+	{
+		static_assert(std::is_trivially_copyable<NetT>::value, "migrating nets must be trivially copyable");
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the rings need address free atomics to work across processes");
+
+		// capacity migrants can wait in each connection, more are dropped until the receiver catches up
+		explicit Migration(const std::vector<std::vector<std::size_t>> &topology, std::size_t capacity = 4) :
+			outgoing(topology.size()),
+			incoming(topology.size()),
+			nextIncoming(topology.size(), 0),
+			capacity(capacity > 0 ? capacity : 1),
+			slotSize((sizeof(NetT) + 63) / 64 * 64),
+			ringSize(sizeof(Ring) + this->capacity * slotSize),
+			base(nullptr),
+			length(0)
+		{
+			std::size_t numRings = 0;
+
+			for (std::size_t from = 0; from < topology.size(); ++from) {
+				for (const std::size_t to : topology[from]) {
+					outgoing[from].push_back(numRings);
+					incoming[to].push_back(numRings);
+					++numRings;
+				}
+			}
+
+			length = numRings * ringSize;
+
+			if (length == 0) {
+				return;
+			}
+
+#ifdef NEURALNET_ISLAND_POSIX
+			void *mapped = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+			base = mapped == MAP_FAILED ? nullptr : static_cast<unsigned char *>(mapped);
+#else
+			// 64 byte aligned within the buffer
+			buffer.resize((length + 64) / 8);
+			base = reinterpret_cast<unsigned char *>((reinterpret_cast<std::uintptr_t>(buffer.data()) + 63) / 64 * 64);
+#endif
+
+			for (std::size_t r = 0; base && r < numRings; ++r) {
+				new (&ring(r)) Ring();
+			}
+		}
+
+		Migration(const Migration &) = delete;
+		Migration &operator=(const Migration &) = delete;
+
+		~Migration() {
+#ifdef NEURALNET_ISLAND_POSIX
+			if (base) {
+				::munmap(base, length);
+			}
+#endif
+		}
+
+		// false if the shared memory could not be mapped
+		bool is_open() const {
+			return base != nullptr || length == 0;
+		}
+
+		std::size_t num_islands() const {
+			return outgoing.size();
+		}
+
+		// net to every island from sends to, returns how many had room. only island from may call this
+		std::size_t send(std::size_t from, const NetT &net) {
+			std::size_t sent = 0;
+
+			for (const std::size_t r : outgoing[from]) {
+				Ring &target = ring(r);
+
+				const std::uint64_t head = target.head.load(std::memory_order_relaxed);
+
+				if (head - target.tail.load(std::memory_order_acquire) >= capacity) {
+					continue;
+				}
+
+				std::memcpy(slot(r, head), &net, sizeof(NetT));
+				target.head.store(head + 1, std::memory_order_release);
+
+				++sent;
+			}
+
+			return sent;
+		}
+
+		// the oldest migrant waiting for island to, taking the connections in turn. only island to may call this
+		bool receive(std::size_t to, NetT &net) {
+			const std::vector<std::size_t> &rings = incoming[to];
+
+			for (std::size_t k = 0; k < rings.size(); ++k) {
+				const std::size_t r = rings[nextIncoming[to]];
+
+				nextIncoming[to] = nextIncoming[to] + 1 < rings.size() ? nextIncoming[to] + 1 : 0;
+
+				Ring &source = ring(r);
+
+				const std::uint64_t tail = source.tail.load(std::memory_order_relaxed);
+
+				if (tail == source.head.load(std::memory_order_acquire)) {
+					continue;
+				}
+
+				std::memcpy(&net, slot(r, tail), sizeof(NetT));
+				source.tail.store(tail + 1, std::memory_order_release);
+
+				return true;
+			}
+
+			return false;
+		}
+
+	private:
+		// the counters only grow, the slot of migrant n is n % capacity
+		struct Ring
+		{
+			alignas(64) std::atomic<std::uint64_t> head; // written by the sender
+			alignas(64) std::atomic<std::uint64_t> tail; // written by the receiver, on its own cache line
+
+			Ring() : head(0), tail(0) {}
+		};
+
+		Ring &ring(std::size_t r) {
+			return *reinterpret_cast<Ring *>(base + r * ringSize);
+		}
+
+		unsigned char *slot(std::size_t r, std::uint64_t n) {
+			return base + r * ringSize + sizeof(Ring) + static_cast<std::size_t>(n % capacity) * slotSize;
+		}
+
+		std::vector<std::vector<std::size_t>> outgoing, incoming; // ring indices per island
+		std::vector<std::size_t> nextIncoming; // per island, local to its process
+		std::size_t capacity, slotSize, ringSize;
+		unsigned char *base;
+		std::size_t length;
+#ifndef NEURALNET_ISLAND_POSIX
+		std::vector<std::uint64_t> buffer;
+#endif
+	};
+
+	// func(island) for island in [0, numIslands), each in a forked process, and waits for all of them.
+	// call it before starting any threads (a child only gets the forking thread). returns whether every island
+	// ran and exited normally
+	template <class Func>
+	bool run_islands(std::size_t numIslands, Func func) {
+#ifdef NEURALNET_ISLAND_POSIX
+		std::vector<pid_t> children;
+
+		// or the children would print the parent's buffered output again
+		std::fflush(nullptr);
+
+		for (std::size_t island = 0; island < numIslands; ++island) {
+			const pid_t pid = ::fork();
+
+			if (pid == 0) {
+				func(island);
+				std::fflush(nullptr);
+				::_exit(0);
+			}
+
+			if (pid < 0) {
+				break;
+			}
+
+			children.push_back(pid);
+		}
+
+		bool ok = children.size() == numIslands;
+
+		for (const pid_t child : children) {
+			int status = 0;
+
+			ok = ::waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+		}
+
+		return ok;
+#else
+		std::vector<std::thread> threads;
+
+		for (std::size_t island = 0; island < numIslands; ++island) {
+			threads.emplace_back([&func, island]() {
+				func(island);
+			});
+		}
+
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+
+		return true;
+#endif
+	}
+}
@@ -5,6 +5,8 @@
 #include <omp.h>
 
 #include "neuralnet.h"
+#include "evolution.h"
+#include "metrics.h"
 
 namespace nn = neuralnet;
 
@@ -41,74 +43,112 @@ const struct ignore_t {
 #include <vector>
 #include <cctype>
 
-// an example single-threaded genetic algo
-template <
-	std::size_t depth,
-	std::size_t input_size,
-	std::size_t output_size,
-	class T,
-	class Generator,
-	class FitnessFunc>
-nn::Net<float, depth, input_size, output_size>
-algo(std::size_t evolutions, std::size_t data_size, Generator generator, FitnessFunc fitnessFunc) {
-	typedef float Weight;
-	typedef nn::Net<Weight, depth, input_size, output_size> NetT;
+#include "algo.h"
 
-	NetT net;
+void math_test() {
+	// progress is sampled in the background, printing every evolution would stall the loop on the console
+	nn::Metrics metrics("algo.metrics.csv");
+
+	AlgoMetrics progress(metrics);
+
+	if (!metrics.start()) {
+		std::cout << "failed to open algo.metrics.csv\n";
+	}
+
+	parallel_algo<1, 32, 1, int>(1000, 10000, math_sample, math_fitness, false, &progress);
+}
+
+#include "backprop.h"
 
-	net.update(nn::RandDistro<Weight>{-1, 1});
+// math_test's task with gradient training: minibatches of 256, counting the samples until 99% accuracy
+void backprop_test() {
+	typedef nn::Net<float, 1, 32, 1> NetT;
 
-	Weight input[input_size];
-	Weight output[output_size];
+	const std::size_t batch_size = 256;
 
-	float bestFitness = 0;
+	NetT net;
 
-	NetT best = net;
+	net.update(nn::RandDistro<float>{-1, 1});
 
-	for (std::size_t evolution = 0; evolution < evolutions; ++evolution) {
-		float fitness = 0;
+	nn::Backprop<NetT> trainer(nn::Backprop<NetT>::Adam, 0.01);
 
-		for (std::size_t i = 0; i < data_size; ++i) {
-			const T value = generator();
+	std::vector<float> inputs(batch_size * 32), targets(batch_size);
 
-			nn::write(input, value);
-			net.calculate(input, output, nn::sigmoid);
+	auto fill = [&]() {
+		for (std::size_t r = 0; r < batch_size; ++r) {
+			const int value = std::rand();
 
-			fitness += fitnessFunc(value, output);
+			nn::write(*reinterpret_cast<float (*)[32]>(&inputs[r * 32]), value);
+			targets[r] = value % 4 == 0 ? 1.0f : 0.0f;
 		}
+	};
 
-		// make sure net == best, so that we can evolve best into net with net.update
-		if (fitness > bestFitness) {
-			best = net;
-			bestFitness = fitness;
-		} else {
-			net = best;
+	for (std::size_t step = 1; step <= 1000; ++step) {
+		fill();
+
+		const double loss = trainer.step(net, inputs.data(), targets.data(), batch_size);
+
+		// accuracy on a fresh batch
+		fill();
+
+		float outputs[batch_size];
+		std::size_t correct = 0;
+
+		net.calculate_batch(inputs.data(), outputs, batch_size, nn::sigmoid);
+
+		for (std::size_t r = 0; r < batch_size; ++r) {
+			correct += (outputs[r] > 0.5f) == (targets[r] > 0.5f) ? 1 : 0;
 		}
 
-		net.update([](Weight weight) {
-			return nn::randf<float>() < 0.05f ? nn::randf(Weight(1), Weight(-1)) : weight;
-		});
+		const double accuracy = static_cast<double>(correct) / batch_size;
 
-		std::cout << evolution << ". " << bestFitness << ", " << fitness << '\n';
-	}
+		std::cout << step << ". loss " << loss << ", accuracy " << accuracy << '\n';
 
-	return best;
+		if (accuracy >= 0.99) {
+			std::cout << "trained on " << step * batch_size << " samples (algo evaluates 10000 per evolution)\n";
+			break;
+		}
+	}
 }
 
-void math_test() {
-	algo<1, 32, 1, int>(1000, 10000, []() {
-		return std::rand();
-	}, [](int value, const float (&output)[1]) -> float {
-		const bool prediction = output[0] > 0.5f;
-		const bool answer = value % 4 == 0;
+// progress of the game tests' evolution loops
+struct GameMetrics
+{
+	explicit GameMetrics(nn::Metrics &metrics) :
+		evaluations(metrics.counter("evaluations")),
+		admitted(metrics.counter("admitted")),
+		games(metrics.counter("games")),
+		inferences(metrics.counter("inferences")),
+		admissionRate(metrics.gauge("admission_rate")),
+		turnsPerGame(metrics.histogram("turns_per_game")),
+		stepTime(metrics.histogram("step_ns")),
+		checkpointTime(metrics.histogram("checkpoint_ns"))
+	{
+	}
 
-		return prediction == answer ? 1.0f : 0.0f;
-	});
-}
+	void add(const std::vector<nn::Score> &scores, std::size_t numAdmitted) {
+		admitted.add(numAdmitted);
+
+		for (const nn::Score &score : scores) {
+			evaluations.add();
+			games.add(score.games);
+			// one net per move
+			inferences.add(score.turns);
+			turnsPerGame.record(score.turns / std::max(score.games, 1));
+		}
+
+		admissionRate.set(static_cast<double>(admitted.load()) / evaluations.load());
+	}
 
-#include "connect4.h"
+	nn::Counter &evaluations, &admitted, &games, &inferences;
+	nn::Gauge &admissionRate;
+	nn::Histogram &turnsPerGame, &stepTime, &checkpointTime;
+};
 
-void connect4_test() {
+#include "players.h"
+#include "quantized.h"
+
+void connect4_test(std::uint64_t seed) {
 	typedef float Weight;
 
 	static const std::size_t input_size = 64;
@@ -118,8 +158,6 @@ void connect4_test() {
 
 	typedef nn::Net<Weight, depth, input_size, output_size> NetT;
 
-	NetT net;
-
 	const std::size_t evolutions = 10000;
 
 	std::vector<NetT> contenders(2048);
@@ -128,114 +166,129 @@ void connect4_test() {
 		contender.update(nn::RandDistro<Weight>{-1, 1});
 	}
 
-	auto make_nn_player = [](const NetT &net) {
-		return [&](const Connect4 &game, Connect4::Cell my_color) -> int {
-			Weight input[input_size];
-			Weight output[output_size];
-
-			int data_i = 0;
+	const int maxPoints = (int)contenders.size() * 2;
+	const int scoreToBeat = 750 * maxPoints / 1000;
 
-			game.each([&](Connect4::Cell cell) {
-				input[data_i] =
-					cell == Connect4::None ? 0.0f :
-					cell == my_color ? 1.0f :
-					2.0f;
+	// mutants evaluated concurrently per generation
+	const std::size_t numCandidates = 8;
 
-				++data_i;
-			});
+	typedef nn::Evolution<NetT> EvolutionT;
 
-			net.calculate(input, output, nn::sigmoid);
+	EvolutionT evolver(contenders, numCandidates, seed);
 
-			int x = -1;
+	// stop playing a candidate once it has passed or can no longer pass, 2 games per contender
+	evolver.pointsPerOpponent = 2;
 
-			Weight maxWeight = -1;
+	// games vary in length, idle workers steal chunks instead of waiting at the end of each generation
+	nn::ThreadPool pool;
+	evolver.pool = &pool;
 
-			for (std::size_t i = 0; i < output_size; ++i) {
-				if (output[i] > maxWeight && game.at(static_cast<int>(i), 0) == Connect4::None) {
-					x = static_cast<int>(i);
-					maxWeight = output[i];
-				}
-			}
-
-			return x;
-		};
+	auto mutate = [](NetT &candidate) {
+		candidate.mutate(0.05 * depth, nn::RandDistro<Weight>{-1, 1});
 	};
 
-	std::size_t parentIndex = 0;
+	// each chunk of contenders plays its games in lock step, one batch per color
+	auto evaluate = [&](const NetT &candidate, std::size_t begin, std::size_t end) {
+		const std::size_t count = end - begin;
 
-	const int maxPoints = (int)contenders.size() * 2;
-	const int scoreToBeat = 750 * maxPoints / 1000;
+		Connect4 boards[EvolutionT::chunkSize];
+		Connect4::Cell results[EvolutionT::chunkSize];
+		int turns[EvolutionT::chunkSize];
 
-	int nextContenderIndex = 0;
+		nn::Score score{0, 0, static_cast<int>(count) * 2};
 
-	std::vector<Connect4> boards;
+		// the candidate meets the same openings in every game, its cached outputs are tagged by its weights
+		const std::uint64_t tag = nn::checkpoint::checksum(candidate.weights(), NetT::num_weights() * sizeof(Weight));
 
-	#pragma omp parallel
-		#pragma omp master
-		{
-			boards.resize(omp_get_num_threads());
-		}
+		Connect4::automate_batch(boards, count, connect4_cached_player(candidate, tag), connect4_each_player(&contenders[begin]), results, turns);
 
-	for (std::size_t evolution = 0; evolution < evolutions; ++evolution) {
-		net = contenders[parentIndex];
+		for (std::size_t i = 0; i < count; ++i) {
+			score.points += results[i] == Connect4::Red ? 1 : 0;
+			score.turns += turns[i];
+		}
 
-		++parentIndex;
+		Connect4::automate_batch(boards, count, connect4_each_player(&contenders[begin]), connect4_cached_player(candidate, tag), results, turns);
 
-		if (parentIndex == contenders.size()) {
-			parentIndex = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			score.points += results[i] == Connect4::Black ? 1 : 0;
+			score.turns += turns[i];
 		}
 
-		net.update([](Weight weight) {
-			return nn::randf<float>() < 0.05f * depth ? nn::randf<Weight>(Weight(1), Weight(-1)) : weight;
-		});
-
-		int score = 0;
-		int numTurns = 0;
+		return score;
+	};
 
-		const int numContenders = (int)contenders.size();
+	// resume an earlier run, and save every checkpointInterval evaluations and at the end
+	const char *checkpointPath = "connect4.ckpt";
+	const std::size_t checkpointInterval = 1024;
 
-		const int bestIndex = (nextContenderIndex > 0 ? nextContenderIndex : numContenders) - 1;
+	if (evolver.restore(checkpointPath)) {
+		std::cout << "resumed " << checkpointPath << " at evo " << evolver.numEvaluated << '\n';
+	} else if (std::ifstream(checkpointPath)) {
+		// starting over would overwrite it at the first checkpoint
+		std::cout << "cannot resume " << checkpointPath << ", move it away to start over\n";
+		return;
+	}
 
+	// sampled in the background, so the workers never wait on the console
+	nn::Metrics metrics("connect4.metrics.csv");
 
-		#pragma omp parallel for reduction(+:score, numTurns)
-		for (int i = 0; i < numContenders; ++i) {
-			Connect4 &board = boards[omp_get_thread_num()];
-			int n;
+	GameMetrics progress(metrics);
 
-			if (Connect4::Red == board.automate(make_nn_player(net), make_nn_player(contenders[i]), n)) {
-				++score;
-			}
+	if (!metrics.start()) {
+		std::cout << "failed to open connect4.metrics.csv\n";
+	}
 
-			numTurns += n;
+	while (evolver.numEvaluated < evolutions) {
+		std::size_t numAdmitted;
 
-			if (Connect4::Black == board.automate(make_nn_player(contenders[i]), make_nn_player(net), n)) {
-				++score;
-			}
+		{
+			nn::ScopedTimer timer(progress.stepTime);
 
-			numTurns += n;
+			numAdmitted = evolver.step(mutate, evaluate, scoreToBeat);
 		}
 
-		// average
-		numTurns /= numContenders * 2;
+		progress.add(evolver.scores, numAdmitted);
 
-		if (score > scoreToBeat) {
-			contenders[nextContenderIndex] = net;
+		if (evolver.numEvaluated % checkpointInterval == 0 || evolver.numEvaluated >= evolutions) {
+			nn::ScopedTimer timer(progress.checkpointTime);
 
-			++nextContenderIndex;
-
-			if (nextContenderIndex >= numContenders) {
-				nextContenderIndex = 0;
+			if (!evolver.save(checkpointPath)) {
+				std::cout << "failed to save " << checkpointPath << '\n';
 			}
-			std::cout << "numTurns " << numTurns << " evo " << evolution << "     !\n";
-		} else {
-			std::cout << "numTurns " << numTurns << " evo " << evolution << "\n";
 		}
 	}
 
+	metrics.stop();
+
 	Connect4::Cell turn = Connect4::Red, playerTurn = turn;
 
 	// play the best
-	const int contenderIndex = nextContenderIndex > 0 ? nextContenderIndex - 1 : (int)contenders.size() - 1;
+	const NetT &best = evolver.best();
+
+	// how often an int8 copy of the best picks the same column, on the positions it meets against the contenders
+	{
+		std::vector<Weight> positions;
+
+		auto recording_player = [&](const Connect4 &game, Connect4::Cell my_color) -> int {
+			positions.resize(positions.size() + input_size);
+			connect4_encode(game, my_color, &positions[positions.size() - input_size]);
+			return connect4_player(best)(game, my_color);
+		};
+
+		for (std::size_t i = 0; i < contenders.size(); i += 8) {
+			Connect4 game;
+			int n;
+
+			game.automate(recording_player, connect4_player(contenders[i]), n);
+			game.reset();
+			game.automate(connect4_player(contenders[i]), recording_player, n);
+		}
+
+		const nn::QuantizedNet<depth, input_size, output_size> quantized(best);
+
+		std::cout << "quantized argmax agreement " << 100 * nn::argmax_agreement(best, quantized, positions.data(), positions.size() / input_size)
+			<< "% over " << positions.size() / input_size << " positions, weights " << sizeof(quantized) << " bytes vs " << sizeof(best) << '\n';
+	}
 
 	Connect4 game;
 
@@ -247,17 +300,18 @@ void connect4_test() {
 	for (;;) {
 		int n;
 
-		auto result = game.automate(human_player, make_nn_player(contenders[contenderIndex]), n);
+		auto result = game.automate(human_player, connect4_player(best), n);
 		game.draw();
 		std::cout << Connect4::CellToString(result) << " won!\n";
 
-		result = game.automate(make_nn_player(contenders[contenderIndex]), human_player, n);
+		result = game.automate(connect4_player(best), human_player, n);
 		game.draw();
 		std::cout << Connect4::CellToString(result) << " won!\n";
 	}
 }
 
 #include "turnbasedbattle.h"
+#include "island.h"
 
 void turnbasedbattle_human_vs_human() {
 	using namespace turnbasedbattle;
@@ -303,7 +357,13 @@ void turnbasedbattle_human_vs_human() {
 	}
 }
 
-void turnbasedbattle_test() {
+typedef nn::Net<float, 1, 6, turnbasedbattle::array_size(turnbasedbattle::actions)> BattleNetT;
+
+// with a migration, runs as one island of turnbasedbattle_islands_test: it evolves its share of the contenders
+// with its own checkpoint, every migrationInterval evaluations sends its latest admitted candidate (if it has a new one)
+// to its neighbours, and admits the migrants it has received
+// with rated, a pool 32 times larger, each candidate playing 2048 of it chosen by rating
+void turnbasedbattle_test(std::uint64_t seed, bool rated = false, nn::Migration<BattleNetT> *migration = nullptr, std::size_t island = 0) {
 	namespace nn = neuralnet;
 	namespace tb = turnbasedbattle;
 
@@ -316,112 +376,167 @@ void turnbasedbattle_test() {
 
 	typedef nn::Net<Weight, depth, input_size, output_size> NetT;
 
-	NetT net;
+	static_assert(std::is_same<NetT, BattleNetT>::value, "BattleNetT must be the net of turnbasedbattle_test");
 
 	const std::size_t evolutions = 10000;
 
-	static const std::size_t numContenders = 2048;
+	const std::size_t numContenders = rated ? 32 * 2048 : 2048;
 
-	std::vector<NetT> contenders(numContenders);
+	const std::size_t numIslands = migration ? migration->num_islands() : 1;
+
+	std::vector<NetT> contenders(numContenders / numIslands);
 
 	for (auto &contender : contenders) {
 		contender.update(nn::RandDistro<Weight>{-1, 1});
 	}
 
-	auto get_nn_player = [](const NetT &net) {
-		return[&](tb::PlayerConstRef self, tb::PlayerConstRef enemy) -> const tb::Action & {
-			Weight input[input_size];
+	const int maxPoints = static_cast<int>(contenders.size());
+	const int scoreToBeat = 618 * maxPoints / 1000;
+	//const int scoreToBeat = 75 * maxPoints / 100;
 
-			input[0] = self.health;
-			input[1] = self.energy;
-			input[2] = self.lastAction == &tb::action_none ? 0.0f : self.lastAction - tb::actions + 1.0f;
-			input[3] = enemy.health;
-			input[4] = enemy.energy;
-			input[5] = enemy.lastAction == &tb::action_none ? 0.0f : enemy.lastAction - tb::actions + 1.0f;
+	// mutants evaluated concurrently per generation
+	const std::size_t numCandidates = 8;
 
-			Weight output[output_size];
+	typedef nn::Evolution<NetT> EvolutionT;
 
-			net.calculate(input, output, nn::sigmoid);
+	EvolutionT evolver(contenders, numCandidates, seed);
 
-			std::size_t max_index = 0;
+	// stop playing a candidate once it has passed or can no longer pass. rated steps play their whole sample
+	evolver.pointsPerOpponent = 1;
 
-			for (std::size_t i = 1; i < output_size; ++i) {
-				if (output[i] > output[max_index] && tb::actions[i].predicate(self, enemy)) {
-					max_index = i;
-				}
-			}
+	nn::EloRatings ratings(contenders.size());
 
-			return tb::actions[max_index];
-		};
+	if (rated) {
+		evolver.ratings = &ratings;
+		evolver.sampleSize = 2048;
+	}
+
+	// islands share the cores
+	const std::size_t numThreads = std::thread::hardware_concurrency() / numIslands;
+
+	nn::ThreadPool pool(numThreads > 0 ? numThreads : 1);
+	evolver.pool = &pool;
+
+	auto mutate = [](NetT &candidate) {
+		candidate.mutate(0.05 * depth, nn::RandDistro<Weight>{-1, 1});
 	};
 
-	// returns 0 = no wins, 1 = a wins, 2 = b wins
-	auto compete = [get_nn_player](const NetT &a, const NetT &b, int &numTurns) -> int {
-		auto p1 = get_nn_player(a);
-		auto p2 = get_nn_player(b);
+	// each chunk of opponents plays its games in lock step. points, if not null, gets the result of each game
+	auto evaluate = [&](const NetT &candidate, std::size_t begin, std::size_t end, int *points) {
+		const std::size_t count = end - begin;
 
-		tb::Game game;
+		tb::Game games[EvolutionT::chunkSize];
+		int turns[EvolutionT::chunkSize];
 
-		numTurns = game.automate(p1, p2, 96);
+		nn::Score score{0, 0, static_cast<int>(count)};
+
+		tb::Game::automate_batch(games, count, turnbasedbattle_batch_player(candidate), turnbasedbattle_each_player(evolver.opponents() + begin), 96, turns);
+
+		for (std::size_t i = 0; i < count; ++i) {
+			const int won = games[i].did_player_win(0) ? 1 : 0;
+
+			if (points) {
+				points[i] = won;
+			}
 
-		return
-			game.did_player_win(0) ? 1 :
-			game.did_player_win(1) ? 2 :
-			0;
+			score.points += won;
+			score.turns += turns[i];
+		}
+
+		return score;
 	};
 
-	std::size_t parentIndex = 0;
+	// each kind of run has its own files
+	const std::string runName = std::string("turnbasedbattle") + (rated ? ".rated" : "") + (migration ? "." + std::to_string(island) : "");
 
-	const int maxPoints = numContenders;
-	const int scoreToBeat = 618 * maxPoints / 1000;
-	//const int scoreToBeat = 75 * maxPoints / 100;
+	// resume an earlier run, and save every checkpointInterval evaluations and at the end
+	const std::string checkpointPath = runName + ".ckpt";
+	const std::size_t checkpointInterval = 1024;
 
-	int nextContenderIndex = 0;
+	const std::size_t migrationInterval = 256;
 
-	for (std::size_t evolution = 0; evolution < evolutions; ++evolution) {
-		net = contenders[parentIndex];
+	// prefixes the output of an island
+	const std::string name = migration ? "island " + std::to_string(island) + ' ' : "";
 
-		++parentIndex;
+	if (evolver.restore(checkpointPath)) {
+		std::cout << name << "resumed " << checkpointPath << " at evo " << evolver.numEvaluated << '\n';
+	} else if (std::ifstream(checkpointPath)) {
+		// starting over would overwrite it at the first checkpoint
+		std::cout << name << "cannot resume " << checkpointPath << ", move it away to start over\n";
+		return;
+	}
 
-		if (parentIndex == numContenders) {
-			parentIndex = 0;
-		}
+	// sampled in the background, so the workers never wait on the console
+	const std::string metricsPath = runName + ".metrics.csv";
 
-		net.update([](Weight weight) {
-			return nn::randf<Weight>() < Weight(0.05) * depth ? nn::randf<Weight>(Weight(1), Weight(-1)) : weight;
-		});
+	nn::Metrics metrics(metricsPath);
 
-		int score = 0, numTurns = 0;
+	metrics.label = name;
 
-		#pragma omp parallel for reduction(+:score, numTurns)
-		for (int i = 0; i < numContenders; ++i) {
-			int n;
+	GameMetrics progress(metrics);
 
-			if (1 == compete(net, contenders[i], n)) {
-				++score;
-			}
+	nn::Counter &migrants = metrics.counter("migrants");
 
-			numTurns += n;
-		}
+	if (!metrics.start()) {
+		std::cout << name << "failed to open " << metricsPath << '\n';
+	}
+
+	// the island's own most recently admitted candidate, as best() may be a migrant.
+	// it is only sent once, so an island that stopped improving does not send the same net again
+	NetT champion;
+	bool newChampion = false;
 
-		numTurns /= numContenders;
+	while (evolver.numEvaluated < evolutions) {
+		std::size_t numAdmitted;
 
-		if (score > scoreToBeat) {
-			contenders[nextContenderIndex] = net;
+		{
+			nn::ScopedTimer timer(progress.stepTime);
+
+			// as hard to pass as scoring 61.8% against an equally rated pool
+			numAdmitted = rated ?
+				evolver.step_rated(mutate, evaluate, ratings.mean() + nn::EloRatings::margin(0.618)) :
+				evolver.step(mutate, [&](const NetT &candidate, std::size_t begin, std::size_t end) {
+					return evaluate(candidate, begin, end, nullptr);
+				}, scoreToBeat);
+		}
 
-			++nextContenderIndex;
+		progress.add(evolver.scores, numAdmitted);
+
+		// migrants are only admitted after this, so best() is still a candidate of this island
+		if (numAdmitted > 0) {
+			champion = evolver.best();
+			newChampion = true;
+		}
 
-			if (nextContenderIndex >= numContenders) {
-				nextContenderIndex = 0;
+		if (migration && evolver.numEvaluated % migrationInterval == 0) {
+			if (newChampion) {
+				migration->send(island, champion);
+				newChampion = false;
 			}
 
-			std::cout << "numTurns " << numTurns << " evo " << evolution << "    !\n";
+			NetT migrant;
+
+			while (migration->receive(island, migrant)) {
+				evolver.admit(migrant);
+				migrants.add();
+			}
 		}
-		else {
-			std::cout << "numTurns " << numTurns << " evo " << evolution << "\n";
+
+		if (evolver.numEvaluated % checkpointInterval == 0 || evolver.numEvaluated >= evolutions) {
+			nn::ScopedTimer timer(progress.checkpointTime);
+
+			if (!evolver.save(checkpointPath)) {
+				std::cout << name << "failed to save " << checkpointPath << '\n';
+			}
 		}
 	}
 
+	metrics.stop();
+
+	if (migration) {
+		return;
+	}
+
 	auto humanPlayer = [](tb::PlayerConstRef self, tb::PlayerConstRef enemy) -> const tb::Action & {
 		std::cout << "self: health: " << self.health << " energy: " << self.energy << " last: " << self.lastAction->name << '\n';
 		std::cout << "enemy: health: " << enemy.health << " energy: " << enemy.energy << " last: " << enemy.lastAction->name << '\n';
@@ -447,7 +562,7 @@ void turnbasedbattle_test() {
 		return tb::actions[action];
 	};
 
-	auto aiPlayer = get_nn_player(contenders[(nextContenderIndex > 0 ? nextContenderIndex  : numContenders) - 1]);
+	auto aiPlayer = turnbasedbattle_player(evolver.best());
 
 	for (;;) {
 		tb::Game game;
@@ -466,15 +581,46 @@ void turnbasedbattle_test() {
 	}
 }
 
+// turnbasedbattle_test split over numIslands processes, each sending its best to the next around a ring
+void turnbasedbattle_islands_test(std::uint64_t seed, std::size_t numIslands) {
+	nn::Migration<BattleNetT> migration(nn::ring_topology(numIslands));
+
+	if (!migration.is_open()) {
+		std::cout << "failed to map the migration rings\n";
+		return;
+	}
+
+	const bool finished = nn::run_islands(numIslands, [&](std::size_t island) {
+		// each island starts from its own contenders
+		nn::seed_random(seed, island);
+
+		turnbasedbattle_test(seed + island, false, &migration, island);
+	});
+
+	std::cout << (finished ? "all islands finished\n" : "an island failed\n");
+}
+
 int main()
 {
-	srand((unsigned int)time(NULL));
+	// runs replay exactly from the same seed, whatever the thread count
+	const std::uint64_t seed = static_cast<std::uint64_t>(time(NULL));
+
+	srand((unsigned int)seed);
+	nn::seed_random(seed);
+
+	std::cout << "seed " << seed << '\n';
 
 	//math_test();
 
-	//connect4_test();
+	//backprop_test();
+
+	//connect4_test(seed);
+
+	turnbasedbattle_test(seed);
+
+	//turnbasedbattle_test(seed, true);
 
-	turnbasedbattle_test();
+	//turnbasedbattle_islands_test(seed, 4);
 	
 	return 0;
 }
\ No newline at end of file
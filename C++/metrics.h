@@ -0,0 +1,326 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// metrics updated with relaxed atomics from any thread and sampled by a background thread, which appends
+// them to a CSV file (and optionally prints a summary line), so hot loops never wait on I/O.
+// the file has one row per metric per sample: seconds,name,total,rate,mean,p50,p99
+// - counter: total so far and its rate per second over the sample interval
+// - gauge: the last value set
+// - histogram: values recorded so far, their rate, and the mean and quantiles of the values of the interval
+namespace neuralnet
+{
+	struct Counter
+	{
+		Counter() : value(0) {}
+
+		void add(std::uint64_t n = 1) {
+			value.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		std::uint64_t load() const {
+			return value.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<std::uint64_t> value;
+	};
+
+	struct Gauge
+	{
+		Gauge() : bits(0) {}
+
+		void set(double value) {
+			std::uint64_t b;
+			std::memcpy(&b, &value, sizeof(b));
+			bits.store(b, std::memory_order_relaxed);
+		}
+
+		double load() const {
+			const std::uint64_t b = bits.load(std::memory_order_relaxed);
+
+			double value;
+			std::memcpy(&value, &b, sizeof(value));
+
+			return value;
+		}
+
+	private:
+		std::atomic<std::uint64_t> bits;
+	};
+
+	// counts values in power of two buckets, quantiles are accurate to within a factor of 2
+	struct Histogram
+	{
+		// bucket 0 holds 0, bucket b holds [2^(b - 1), 2^b)
+		static const std::size_t numBuckets = 65;
+
+		Histogram() : sum(0) {
+			for (auto &bucket : buckets) {
+				bucket.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		void record(std::uint64_t value) {
+			buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+			sum.fetch_add(value, std::memory_order_relaxed);
+		}
+
+		// the number of significant bits of value
+		static std::size_t bucket(std::uint64_t value) {
+			std::size_t b = 0;
+
+			for (std::size_t shift = 32; shift > 0; shift /= 2) {
+				if (value >> shift) {
+					value >>= shift;
+					b += shift;
+				}
+			}
+
+			return b + (value != 0 ? 1 : 0);
+		}
+
+		std::atomic<std::uint64_t> buckets[numBuckets];
+		std::atomic<std::uint64_t> sum;
+	};
+
+	// records the nanoseconds from construction to destruction, e.g. of a phase of a loop
+	struct ScopedTimer
+	{
+		explicit ScopedTimer(Histogram &histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+		~ScopedTimer() {
+			histogram.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+		}
+
+		ScopedTimer(const ScopedTimer &) = delete;
+		ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+	private:
+		Histogram &histogram;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	// named metrics and the thread sampling them every interval seconds into path. register every metric
+	// before start (their references stay valid). with console, each sample also prints one line to stdout
+	struct Metrics
+	{
+		explicit Metrics(const std::string &path, double interval = 1.0, bool console = true) :
+			path(path),
+			interval(interval),
+			console(console),
+			file(nullptr),
+			stopping(false)
+		{
+		}
+
+		// prefixes the console lines, e.g. to tell processes apart
+		std::string label;
+
+		Metrics(const Metrics &) = delete;
+		Metrics &operator=(const Metrics &) = delete;
+
+		~Metrics() {
+			stop();
+		}
+
+		Counter &counter(const std::string &name) {
+			counters.emplace_back();
+			counters.back().name = name;
+			return counters.back().metric;
+		}
+
+		Gauge &gauge(const std::string &name) {
+			gauges.emplace_back();
+			gauges.back().name = name;
+			return gauges.back().metric;
+		}
+
+		Histogram &histogram(const std::string &name) {
+			histograms.emplace_back();
+			histograms.back().name = name;
+			return histograms.back().metric;
+		}
+
+		// opens path (appending if it exists) and starts sampling, returns false if path cannot be opened
+		bool start() {
+			if (file) {
+				return true;
+			}
+
+			file = std::fopen(path.c_str(), "a");
+
+			if (!file) {
+				return false;
+			}
+
+			if (std::ftell(file) == 0) {
+				std::fputs("seconds,name,total,rate,mean,p50,p99\n", file);
+			}
+
+			begin = last = std::chrono::steady_clock::now();
+			stopping = false;
+
+			writer = std::thread([this]() {
+				std::unique_lock<std::mutex> lock(mutex);
+
+				while (!wake.wait_for(lock, std::chrono::duration<double>(this->interval), [this]() { return stopping; })) {
+					sample();
+				}
+			});
+
+			return true;
+		}
+
+		// takes a last sample and closes the file
+		void stop() {
+			if (!file) {
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+
+			wake.notify_all();
+			writer.join();
+
+			sample();
+
+			std::fclose(file);
+			file = nullptr;
+		}
+
+	private:
+		template <class Metric>
+		struct Named
+		{
+			std::string name;
+			Metric metric;
+			std::uint64_t previous = 0; // counter total or histogram count at the last sample
+			std::vector<std::uint64_t> previousBuckets;
+			std::uint64_t previousSum = 0;
+		};
+
+		void sample() {
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+			const double seconds = std::chrono::duration<double>(now - begin).count();
+			const double elapsed = std::chrono::duration<double>(now - last).count();
+
+			last = now;
+
+			std::string line = label;
+			char text[256];
+
+			std::snprintf(text, sizeof(text), "%.1fs", seconds);
+			line += text;
+
+			for (auto &counter : counters) {
+				const std::uint64_t total = counter.metric.load();
+				const double rate = elapsed > 0 ? (total - counter.previous) / elapsed : 0;
+
+				counter.previous = total;
+
+				std::fprintf(file, "%.3f,%s,%llu,%g,,,\n", seconds, counter.name.c_str(), static_cast<unsigned long long>(total), rate);
+
+				std::snprintf(text, sizeof(text), " | %s %llu (%.4g/s)", counter.name.c_str(), static_cast<unsigned long long>(total), rate);
+				line += text;
+			}
+
+			for (auto &gauge : gauges) {
+				const double value = gauge.metric.load();
+
+				std::fprintf(file, "%.3f,%s,%g,,,,\n", seconds, gauge.name.c_str(), value);
+
+				std::snprintf(text, sizeof(text), " | %s %.4g", gauge.name.c_str(), value);
+				line += text;
+			}
+
+			for (auto &histogram : histograms) {
+				Histogram &h = histogram.metric;
+
+				histogram.previousBuckets.resize(Histogram::numBuckets, 0);
+
+				std::uint64_t counts[Histogram::numBuckets], total = 0, count = 0;
+
+				for (std::size_t b = 0; b < Histogram::numBuckets; ++b) {
+					const std::uint64_t value = h.buckets[b].load(std::memory_order_relaxed);
+
+					counts[b] = value - histogram.previousBuckets[b];
+					histogram.previousBuckets[b] = value;
+
+					total += value;
+					count += counts[b];
+				}
+
+				const std::uint64_t sum = h.sum.load(std::memory_order_relaxed);
+				const double mean = count > 0 ? static_cast<double>(sum - histogram.previousSum) / count : 0;
+
+				histogram.previousSum = sum;
+				histogram.previous = total;
+
+				const double rate = elapsed > 0 ? count / elapsed : 0;
+				const double p50 = quantile(counts, count, 0.5), p99 = quantile(counts, count, 0.99);
+
+				std::fprintf(file, "%.3f,%s,%llu,%g,%g,%g,%g\n", seconds, histogram.name.c_str(), static_cast<unsigned long long>(total), rate, mean, p50, p99);
+
+				std::snprintf(text, sizeof(text), " | %s mean %.4g p99 %.4g", histogram.name.c_str(), mean, p99);
+				line += text;
+			}
+
+			std::fflush(file);
+
+			if (console) {
+				std::printf("%s\n", line.c_str());
+				std::fflush(stdout);
+			}
+		}
+
+		// the middle of the bucket holding quantile q of count values
+		static double quantile(const std::uint64_t *counts, std::uint64_t count, double q) {
+			if (count == 0) {
+				return 0;
+			}
+
+			const double rank = q * (count - 1);
+			std::uint64_t seen = 0;
+
+			for (std::size_t b = 0; b < Histogram::numBuckets; ++b) {
+				seen += counts[b];
+
+				if (seen > rank) {
+					return b == 0 ? 0.0 : 1.5 * std::ldexp(1.0, static_cast<int>(b) - 1);
+				}
+			}
+
+			return 0;
+		}
+
+		std::string path;
+		double interval;
+		bool console;
+		std::FILE *file;
+		std::chrono::steady_clock::time_point begin, last;
+		std::deque<Named<Counter>> counters;
+		std::deque<Named<Gauge>> gauges;
+		std::deque<Named<Histogram>> histograms;
+		std::thread writer;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping;
+	};
+}
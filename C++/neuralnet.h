@@ -1,30 +1,23 @@
 #pragma once
 
 #include <algorithm>
-#include <random>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "activation.h"
+#include "random.h"
+#include "simd.h"
 
 namespace neuralnet
 {
-	namespace detail
-	{
-		namespace random
-		{
-			constexpr std::uint64_t max = std::numeric_limits<std::uint64_t>::max();
-
-			std::random_device device;
-			std::mt19937_64 engine(device());
-			std::uniform_int_distribution<std::uint64_t> distribution(0, max);
-
-			std::uint64_t next() {
-				return distribution(engine);
-			}
-		}
-	}
-
+	// uniform in [0, 1) from the calling thread's generator
 	template <class T>
 	T randf() {
-		return static_cast<T>(detail::random::next()) / detail::random::max;
+		return CounterRng::unit<T>(detail::random::next());
 	}
 
 	template <class T>
@@ -47,12 +40,98 @@ namespace neuralnet
 		}
 	};
 
-	const struct sigmoid_t {
-		template <class T>
-		constexpr T operator()(T value) const {
-			return 1 / (1 + std::exp(-value));
+	namespace detail
+	{
+		// activators with a domain() clamp first, in a loop of its own
+		template <class Activator, class Weight>
+		void activate_block(Activator, Weight *values, std::ptrdiff_t size, decltype(Activator::domain()) *) {
+			const Weight min = static_cast<Weight>(-Activator::domain()), max = static_cast<Weight>(Activator::domain());
+
+			for (std::ptrdiff_t i = 0; i < size; ++i) {
+				values[i] = values[i] < min ? min : values[i] > max ? max : values[i];
+			}
+
+			for (std::ptrdiff_t i = 0; i < size; ++i) {
+				values[i] = Activator::unclamped(values[i]);
+			}
+		}
+
+		template <class Activator, class Weight>
+		void activate_block(Activator activator, Weight *values, std::ptrdiff_t size, ...) {
+			for (std::ptrdiff_t i = 0; i < size; ++i) {
+				values[i] = activator(values[i]);
+			}
+		}
+
+		// whole blocks have a constant trip count, which compilers vectorize at -O2 for branch free activators
+		template <class Activator, class Weight>
+		void activate(Activator activator, Weight *begin, Weight *end) {
+			const std::ptrdiff_t block = 16;
+
+			for (; end - begin >= block; begin += block) {
+				activate_block(activator, begin, block, nullptr);
+			}
+
+			activate_block(activator, begin, end - begin, nullptr);
+		}
+
+		inline void activate(sigmoid_t, float *begin, float *end) {
+			simd::kernels().sigmoid(begin, static_cast<std::size_t>(end - begin));
+		}
+
+		template <class Weight>
+		void activate(identity_t, Weight *, Weight *) {
+		}
+
+		// layers with at most this many weights are calculated by the fused, unrolled kernel below
+		const std::size_t fusedMaxWeights = 256;
+
+		// result + inputs[j] * weights[j] + ... + inputs[n - 1] * weights[n - 1], unrolled at compile time,
+		// accumulating in the same order as the scalar loop
+		template <std::size_t j, std::size_t n, class Weight>
+		Weight dot_unrolled(Weight result, const Weight *, const Weight *, std::true_type) {
+			return result;
+		}
+
+		template <std::size_t j, std::size_t n, class Weight>
+		Weight dot_unrolled(Weight result, const Weight *inputs, const Weight *weights, std::false_type) {
+			return dot_unrolled<j + 1, n>(result + inputs[j] * weights[j], inputs, weights, std::integral_constant<bool, j + 1 == n>());
+		}
+
+		// bias, dot product and activation of one neuron with n weights, without leaving registers
+		template <std::size_t n, class Weight, class Activator>
+		Weight fused_neuron(const Weight *weights, Weight bias, const Weight *inputs, Activator activator) {
+			return activator(dot_unrolled<0, n>(-bias, inputs, weights, std::integral_constant<bool, n == 0>()));
+		}
+
+		// activators that are faster as a vector pass over a whole layer output than per neuron:
+		// the float sigmoid kernel and the clamped approximations. the fused kernel applies them after its rows.
+		template <class Activator, class Weight>
+		std::true_type deferred_activation(decltype(Activator::domain()) *) {
+			return std::true_type();
 		}
-	} sigmoid = {};
+
+		template <class Activator, class Weight>
+		typename std::is_same<std::pair<Activator, Weight>, std::pair<sigmoid_t, float>>::type deferred_activation(...) {
+			return typename std::is_same<std::pair<Activator, Weight>, std::pair<sigmoid_t, float>>::type();
+		}
+
+		// rows of fused neurons: outputs[r * size + i] = activator(-biases[i] + inputs[r] . weights[i])
+		template <std::size_t size, std::size_t n, class Weight, class LayerT, class Activator>
+		void fused_layer(const LayerT &layer, const Weight *inputs, Weight *outputs, std::size_t count, Activator activator, std::false_type) {
+			for (std::size_t r = 0; r < count; ++r, inputs += n, outputs += size) {
+				for (std::size_t i = 0; i < size; ++i) {
+					outputs[i] = fused_neuron<n>(layer.row(i), layer.bias(i), inputs, activator);
+				}
+			}
+		}
+
+		template <std::size_t size, std::size_t n, class Weight, class LayerT, class Activator>
+		void fused_layer(const LayerT &layer, const Weight *inputs, Weight *outputs, std::size_t count, Activator activator, std::true_type) {
+			fused_layer<size, n>(layer, inputs, outputs, count, identity, std::false_type());
+			activate(activator, outputs, outputs + count * size);
+		}
+	}
 
 	template <class Weight, std::size_t size>
 	struct Neuron
@@ -91,13 +170,231 @@ namespace neuralnet
 		}
 
 		void calculate(const Weight (&inputs)[neuronSize], Weight (&outputs)[size]) const
+		{
+			calculate(inputs, outputs, typename std::is_same<Weight, float>::type());
+		}
+
+		// inputs is count rows of neuronSize weights, outputs is count rows of size weights
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count) const
+		{
+			calculate_batch(inputs, outputs, count, typename std::is_same<Weight, float>::type());
+		}
+
+		// calculate, then activator on every output. small layers do both in one unrolled pass.
+		template <class Activator>
+		void calculate(const Weight (&inputs)[neuronSize], Weight (&outputs)[size], Activator activator) const
+		{
+			calculate_batch(inputs, outputs, 1, activator);
+		}
+
+		template <class Activator>
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, Activator activator) const
+		{
+			calculate_batch(inputs, outputs, count, activator, std::integral_constant<bool, size * neuronSize <= detail::fusedMaxWeights>());
+		}
+
+		// the neuronSize weights and the bias of neuron i, the same for every layer type
+		Weight *row(std::size_t i) {
+			return neurons[i].weights;
+		}
+
+		const Weight *row(std::size_t i) const {
+			return neurons[i].weights;
+		}
+
+		Weight &bias(std::size_t i) {
+			return neurons[i].bias;
+		}
+
+		Weight bias(std::size_t i) const {
+			return neurons[i].bias;
+		}
+
+		NeuronT neurons[size];
+
+	private:
+		template <class Activator>
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, Activator activator, std::true_type) const
+		{
+			detail::fused_layer<size, neuronSize>(*this, inputs, outputs, count, activator, detail::deferred_activation<Activator, Weight>(nullptr));
+		}
+
+		template <class Activator>
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, Activator activator, std::false_type) const
+		{
+			calculate_batch(inputs, outputs, count);
+			detail::activate(activator, outputs, outputs + count * size);
+		}
+
+		static const std::size_t stride = sizeof(NeuronT) / sizeof(Weight);
+
+		void calculate(const Weight *inputs, Weight *outputs, std::true_type) const
+		{
+			static_assert(stride == neuronSize + 1, "neuron bias must directly follow its weights");
+
+			simd::kernels().layer(neurons[0].weights, stride, &neurons[0].bias, stride, size, neuronSize, inputs, outputs);
+		}
+
+		void calculate(const Weight *inputs, Weight *outputs, std::false_type) const
 		{
 			for (std::size_t i = 0; i < size; ++i) {
-				outputs[i] = neurons[i].calculate(inputs);
+				outputs[i] = neurons[i].calculate(*reinterpret_cast<const Weight (*)[neuronSize]>(inputs));
 			}
 		}
 
-		NeuronT neurons[size];
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, std::true_type) const
+		{
+			static_assert(stride == neuronSize + 1, "neuron bias must directly follow its weights");
+
+			simd::kernels().layer_batch(neurons[0].weights, stride, &neurons[0].bias, stride, size, neuronSize, inputs, outputs, count);
+		}
+
+		// rows are processed 4 at a time so each neuron's weights are loaded once per 4 inputs
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, std::false_type) const
+		{
+			std::size_t n = 0;
+
+			for (; n + 4 <= count; n += 4) {
+				const Weight * const in0 = inputs + n * neuronSize;
+				const Weight * const in1 = in0 + neuronSize;
+				const Weight * const in2 = in1 + neuronSize;
+				const Weight * const in3 = in2 + neuronSize;
+
+				Weight * const out0 = outputs + n * size;
+				Weight * const out1 = out0 + size;
+				Weight * const out2 = out1 + size;
+				Weight * const out3 = out2 + size;
+
+				for (std::size_t i = 0; i < size; ++i) {
+					const NeuronT &neuron = neurons[i];
+
+					Weight r0 = -neuron.bias, r1 = r0, r2 = r0, r3 = r0;
+
+					for (std::size_t j = 0; j < neuronSize; ++j) {
+						const Weight weight = neuron.weights[j];
+
+						r0 += in0[j] * weight;
+						r1 += in1[j] * weight;
+						r2 += in2[j] * weight;
+						r3 += in3[j] * weight;
+					}
+
+					out0[i] = r0;
+					out1[i] = r1;
+					out2[i] = r2;
+					out3[i] = r3;
+				}
+			}
+
+			for (; n < count; ++n) {
+				calculate(inputs + n * neuronSize, outputs + n * size, std::false_type());
+			}
+		}
+	};
+
+	// same interface as Layer, but stored as one weight matrix plus a separate bias vector.
+	// rows are zero padded to whole cache lines and the matrix is cache line aligned, so a net
+	// of MatrixLayers is a single flat block with aligned rows (pre C++17 operator new does not
+	// honour the alignment, so heap allocated nets are only guaranteed alignof(max_align_t)).
+	template <class Weight, std::size_t size, std::size_t neuronSize>
+	struct alignas(64) MatrixLayer
+	{
+		static const std::size_t alignment = 64;
+		static const std::size_t stride = (neuronSize * sizeof(Weight) + alignment - 1) / alignment * alignment / sizeof(Weight);
+
+		MatrixLayer() : weights(), biases() {}
+
+		template <class Func>
+		void update(Func func) {
+			for (std::size_t i = 0; i < size; ++i) {
+				std::transform(weights[i], weights[i] + neuronSize, weights[i], func);
+				biases[i] = func(biases[i]);
+			}
+		}
+
+		void calculate(const Weight (&inputs)[neuronSize], Weight (&outputs)[size]) const
+		{
+			calculate_batch(inputs, outputs, 1);
+		}
+
+		// inputs is count rows of neuronSize weights, outputs is count rows of size weights
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count) const
+		{
+			calculate_batch(inputs, outputs, count, typename std::is_same<Weight, float>::type());
+		}
+
+		// calculate, then activator on every output. small layers do both in one unrolled pass.
+		template <class Activator>
+		void calculate(const Weight (&inputs)[neuronSize], Weight (&outputs)[size], Activator activator) const
+		{
+			calculate_batch(inputs, outputs, 1, activator);
+		}
+
+		template <class Activator>
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, Activator activator) const
+		{
+			calculate_batch(inputs, outputs, count, activator, std::integral_constant<bool, size * neuronSize <= detail::fusedMaxWeights>());
+		}
+
+		Weight *row(std::size_t i) {
+			return weights[i];
+		}
+
+		const Weight *row(std::size_t i) const {
+			return weights[i];
+		}
+
+		Weight &bias(std::size_t i) {
+			return biases[i];
+		}
+
+		Weight bias(std::size_t i) const {
+			return biases[i];
+		}
+
+		alignas(alignment) Weight weights[size][stride];
+		alignas(alignment) Weight biases[size];
+
+	private:
+		template <class Activator>
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, Activator activator, std::true_type) const
+		{
+			detail::fused_layer<size, neuronSize>(*this, inputs, outputs, count, activator, detail::deferred_activation<Activator, Weight>(nullptr));
+		}
+
+		template <class Activator>
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, Activator activator, std::false_type) const
+		{
+			calculate_batch(inputs, outputs, count);
+			detail::activate(activator, outputs, outputs + count * size);
+		}
+
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, std::true_type) const
+		{
+			if (count == 1) {
+				simd::kernels().layer(weights[0], stride, biases, 1, size, neuronSize, inputs, outputs);
+			} else {
+				simd::kernels().layer_batch(weights[0], stride, biases, 1, size, neuronSize, inputs, outputs, count);
+			}
+		}
+
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, std::false_type) const
+		{
+			for (std::size_t n = 0; n < count; ++n) {
+				const Weight * const in = inputs + n * neuronSize;
+				Weight * const out = outputs + n * size;
+
+				for (std::size_t i = 0; i < size; ++i) {
+					Weight result = -biases[i];
+
+					for (std::size_t j = 0; j < neuronSize; ++j) {
+						result += in[j] * weights[i][j];
+					}
+
+					out[i] = result;
+				}
+			}
+		}
 	};
 
 	template <class Weight, std::size_t size, class T, class Test = std::enable_if_t<std::is_integral<T>::value>>
@@ -120,15 +417,143 @@ namespace neuralnet
 		}
 	}
 
-	template <class Weight, std::size_t depth, std::size_t size, std::size_t outputSize>
-	struct Net
+	namespace detail
+	{
+		// outputs (rows * count) = inputs (rows * n) times count neurons laid out as n weights then a bias
+		template <class Weight>
+		void dense_batch(const Weight *neurons, std::size_t count, std::size_t n, const Weight *inputs, Weight *outputs, std::size_t rows) {
+			for (std::size_t r = 0; r < rows; ++r) {
+				const Weight * const in = inputs + r * n;
+				Weight * const out = outputs + r * count;
+
+				for (std::size_t i = 0; i < count; ++i) {
+					const Weight * const weights = neurons + i * (n + 1);
+
+					Weight result = -weights[n];
+
+					for (std::size_t j = 0; j < n; ++j) {
+						result += in[j] * weights[j];
+					}
+
+					out[i] = result;
+				}
+			}
+		}
+
+		inline void dense_batch(const float *neurons, std::size_t count, std::size_t n, const float *inputs, float *outputs, std::size_t rows) {
+			simd::kernels().layer_batch(neurons, n + 1, neurons + n, n + 1, count, n, inputs, outputs, rows);
+		}
+	}
+
+	// replaces each weight with func(weight) with the given probability, but only visits the weights
+	// it changes: the gaps between changes are drawn from the geometric distribution, so the cost is
+	// one draw per changed weight instead of one per weight. changed (optional) receives the indices.
+	template <class Weight, class Func>
+	std::size_t mutate_sparse(Weight *weights, std::size_t size, double probability, Func func, std::vector<std::uint32_t> *changed = nullptr) {
+		if (probability <= 0) {
+			return 0;
+		}
+
+		const double logKeep = std::log1p(-std::min(probability, 1.0));
+
+		std::size_t numChanged = 0;
+
+		for (std::size_t i = 0;; ++i) {
+			if (probability < 1) {
+				const double skip = std::floor(std::log(1 - randf<double>()) / logKeep);
+
+				if (skip >= static_cast<double>(size - i)) {
+					break;
+				}
+
+				i += static_cast<std::size_t>(skip);
+			} else if (i >= size) {
+				break;
+			}
+
+			weights[i] = func(weights[i]);
+
+			if (changed) {
+				changed->push_back(static_cast<std::uint32_t>(i));
+			}
+
+			++numChanged;
+		}
+
+		return numChanged;
+	}
+
+	// CRTP base shared by the feed forward nets. Derived exposes its weights as one flat array
+	// (weights() and num_weights()), which is all generic code like mutation or serialization needs.
+	template <class Derived, class Weight>
+	struct FeedForwardNet
 	{
-		typedef Layer<Weight, size, size> LayerT;
-		typedef Layer<Weight, outputSize, size> OutputLayerT;
+		typedef Weight WeightT;
+
+		// func(weight, index) -> weight, like the JS Net.update
+		template <class Func>
+		void update_indexed(Func func) {
+			Weight * const weights = derived().weights();
+			const std::size_t numWeights = derived().num_weights();
+
+			for (std::size_t i = 0; i < numWeights; ++i) {
+				weights[i] = func(weights[i], i);
+			}
+		}
+
+		// mutate_sparse over the flat weights (for MatrixLayer nets this includes the unused row padding)
+		template <class Func>
+		std::size_t mutate(double probability, Func func, std::vector<std::uint32_t> *changed = nullptr) {
+			return mutate_sparse(derived().weights(), derived().num_weights(), probability, func, changed);
+		}
+
+		// requires equal topologies, only copies weights
+		Derived &copy_weights(const Derived &other) {
+			std::copy(other.weights(), other.weights() + other.num_weights(), derived().weights());
+			return derived();
+		}
+
+	private:
+		Derived &derived() {
+			return static_cast<Derived &>(*this);
+		}
+	};
+
+	// LayerTemplate may be Layer (array of neurons) or MatrixLayer (padded weight matrix + bias vector)
+	template <class Weight, std::size_t depth, std::size_t size, std::size_t outputSize, template <class, std::size_t, std::size_t> class LayerTemplate = Layer>
+	struct Net : FeedForwardNet<Net<Weight, depth, size, outputSize, LayerTemplate>, Weight>
+	{
+		typedef LayerTemplate<Weight, size, size> LayerT;
+		typedef LayerTemplate<Weight, outputSize, size> OutputLayerT;
 
 		LayerT hiddenLayers[depth];
 		OutputLayerT outputLayer;
 
+		static constexpr std::size_t input_size() {
+			return size;
+		}
+
+		static constexpr std::size_t output_size() {
+			return outputSize;
+		}
+
+		static constexpr std::size_t num_hidden_layers() {
+			return depth;
+		}
+
+		// the whole net viewed as one array, in update order. for MatrixLayer this includes the row padding, which is never read.
+		static constexpr std::size_t num_weights() {
+			return sizeof(LayerT) / sizeof(Weight) * depth + sizeof(OutputLayerT) / sizeof(Weight);
+		}
+
+		Weight *weights() {
+			return reinterpret_cast<Weight *>(hiddenLayers);
+		}
+
+		const Weight *weights() const {
+			return reinterpret_cast<const Weight *>(hiddenLayers);
+		}
+
 		template <class Func>
 		void update(Func func) {
 			for (auto &layer : hiddenLayers) {
@@ -145,20 +570,161 @@ namespace neuralnet
 
 			InputT data1, data2;
 
-			hiddenLayers[0].calculate(inputs, data1);
+			// the first hidden layer is not activated
+			hiddenLayers[0].calculate(inputs, data1, identity);
 
 			InputT *d1 = &data1, *d2 = &data2;
 
 			for (std::size_t i = 1; i < depth; ++i) {
-				hiddenLayers[i].calculate(*d1, *d2);
-				std::transform(*d2, *d2 + size, *d2, activator);
+				hiddenLayers[i].calculate(*d1, *d2, activator);
 				std::swap(d1, d2);
 			}
 
-			outputLayer.calculate(*d1, outputs);
+			outputLayer.calculate(*d1, outputs, activator);
+		}
+
+		// max rows per tile in calculate_batch, bounds the stack used for intermediate layers
+		static const std::size_t batchTile = 32;
+
+		// same as calculate, but for count inputs stored contiguously (count rows of size weights),
+		// writing count rows of outputSize weights. each layer runs as one matrix-matrix product per tile.
+		template <class Activator>
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, Activator activator) const
+		{
+			Weight data1[batchTile * size], data2[batchTile * size];
+
+			for (std::size_t begin = 0; begin < count; begin += batchTile) {
+				const std::size_t rows = count - begin < batchTile ? count - begin : batchTile;
+
+				hiddenLayers[0].calculate_batch(inputs + begin * size, data1, rows, identity);
+
+				Weight *d1 = data1, *d2 = data2;
+
+				for (std::size_t i = 1; i < depth; ++i) {
+					hiddenLayers[i].calculate_batch(d1, d2, rows, activator);
+					std::swap(d1, d2);
+				}
+
+				outputLayer.calculate_batch(d1, outputs + begin * outputSize, rows, activator);
+			}
+		}
+	};
+
+	// feed forward net with any number of layers of any size, e.g. {64, 32, 8}, like the JS neuralnet.Net.
+	// all weights live in one contiguous arena laid out like Layer (each neuron's weights then its bias),
+	// so a Net<Weight, depth, size, outputSize> converts to a DynamicNet({size, size..., outputSize}) with
+	// identical results. as in Net, the first layer's outputs are not activated unless it is the output layer.
+	template <class Weight>
+	struct DynamicNet : FeedForwardNet<DynamicNet<Weight>, Weight>
+	{
+		explicit DynamicNet(const std::vector<std::size_t> &sizes) :
+			sizes(sizes),
+			offsets(sizes.size() - 1),
+			maxSize(*std::max_element(sizes.begin(), sizes.end()))
+		{
+			std::size_t numWeights = 0;
+
+			for (std::size_t i = 0; i + 1 < sizes.size(); ++i) {
+				offsets[i] = numWeights;
+				numWeights += (sizes[i] + 1) * sizes[i + 1]; // +1 for bias
+			}
+
+			arena.resize(numWeights);
+		}
+
+		template <std::size_t depth, std::size_t size, std::size_t outputSize>
+		explicit DynamicNet(const Net<Weight, depth, size, outputSize> &net) :
+			DynamicNet(net_sizes(depth, size, outputSize))
+		{
+			std::copy(net.weights(), net.weights() + net.num_weights(), arena.begin());
+		}
+
+		const std::vector<std::size_t> &layer_sizes() const {
+			return sizes;
+		}
+
+		std::size_t input_size() const {
+			return sizes.front();
+		}
+
+		std::size_t output_size() const {
+			return sizes.back();
+		}
 
-			std::transform(outputs, std::end(outputs), outputs, activator);
+		std::size_t num_weights() const {
+			return arena.size();
 		}
+
+		Weight *weights() {
+			return arena.data();
+		}
+
+		const Weight *weights() const {
+			return arena.data();
+		}
+
+		template <class Func>
+		void update(Func func) {
+			std::transform(arena.begin(), arena.end(), arena.begin(), func);
+		}
+
+		template <class Activator>
+		void calculate(const Weight *inputs, Weight *outputs, Activator activator) const
+		{
+			calculate_batch(inputs, outputs, 1, activator);
+		}
+
+		// max rows per tile in calculate_batch
+		static const std::size_t batchTile = 32;
+
+		// count rows of input_size() inputs to count rows of output_size() outputs
+		template <class Activator>
+		void calculate_batch(const Weight *inputs, Weight *outputs, std::size_t count, Activator activator) const
+		{
+			// scratch is per thread so a shared net can be evaluated concurrently without allocating per call
+			static thread_local std::vector<Weight> scratch;
+
+			if (scratch.size() < 2 * batchTile * maxSize) {
+				scratch.resize(2 * batchTile * maxSize);
+			}
+
+			const std::size_t numLayers = offsets.size();
+
+			for (std::size_t begin = 0; begin < count; begin += batchTile) {
+				const std::size_t rows = count - begin < batchTile ? count - begin : batchTile;
+
+				const Weight *in = inputs + begin * sizes.front();
+				Weight *d1 = scratch.data(), *d2 = d1 + batchTile * maxSize;
+
+				for (std::size_t i = 0; i < numLayers; ++i) {
+					const bool last = i + 1 == numLayers;
+					const std::size_t n = sizes[i], outSize = sizes[i + 1];
+
+					Weight * const out = last ? outputs + begin * outSize : d2;
+
+					detail::dense_batch(arena.data() + offsets[i], outSize, n, in, out, rows);
+
+					if (i > 0 || last) {
+						detail::activate(activator, out, out + rows * outSize);
+					}
+
+					in = out;
+					std::swap(d1, d2);
+				}
+			}
+		}
+
+	private:
+		static std::vector<std::size_t> net_sizes(std::size_t depth, std::size_t size, std::size_t outputSize) {
+			std::vector<std::size_t> result(depth + 1, size);
+			result.push_back(outputSize);
+			return result;
+		}
+
+		std::vector<std::size_t> sizes;
+		std::vector<std::size_t> offsets;
+		std::size_t maxSize;
+		std::vector<Weight> arena;
 	};
 }
 
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cache.h"
+#include "connect4.h"
+#include "neuralnet.h"
+#include "turnbasedbattle.h"
+
+// how a net sees and plays the example games, shared by the tests and the benchmarks.
+// the batch players are for the games' automate_batch, each player for the games' automate
+
+// 0 = empty, 1 = mine, 2 = theirs, row by row from the top
+template <class Weight>
+void connect4_encode(const Connect4 &game, Connect4::Cell my_color, Weight *input) {
+	game.each([&](Connect4::Cell cell) {
+		*input++ =
+			cell == Connect4::None ? Weight(0) :
+			cell == my_color ? Weight(1) :
+			Weight(2);
+	});
+}
+
+// the highest scoring column that is not full, -1 if there is none
+template <class Weight>
+int connect4_choose(const Connect4 &game, const Weight *output, std::size_t output_size) {
+	int x = -1;
+
+	Weight maxWeight = -1;
+
+	for (std::size_t i = 0; i < output_size; ++i) {
+		if (output[i] > maxWeight && game.at(static_cast<int>(i), 0) == Connect4::None) {
+			x = static_cast<int>(i);
+			maxWeight = output[i];
+		}
+	}
+
+	return x;
+}
+
+template <class NetT>
+auto connect4_player(const NetT &net) {
+	return [&net](const Connect4 &game, Connect4::Cell my_color) -> int {
+		typename NetT::WeightT input[NetT::input_size()];
+		typename NetT::WeightT output[NetT::output_size()];
+
+		connect4_encode(game, my_color, input);
+
+		net.calculate(input, output, neuralnet::sigmoid);
+
+		return connect4_choose(game, output, NetT::output_size());
+	};
+}
+
+// one batched inference per ply for the live games whose position net has not seen yet under tag,
+// the outputs of the others come from a per thread cache. the input only depends on which pieces are
+// mine and theirs, so those two masks are the key
+template <class NetT>
+auto connect4_cached_player(const NetT &net, std::uint64_t tag) {
+	typedef typename NetT::WeightT Weight;
+
+	static const std::size_t input_size = NetT::input_size();
+	static const std::size_t output_size = NetT::output_size();
+
+	return [&net, tag](const Connect4 *boards, const std::size_t *indices, std::size_t n, Connect4::Cell my_color, int *moves) {
+		static thread_local neuralnet::OutputCache<Weight, output_size> cache;
+		static thread_local std::vector<Weight> inputs, outputs;
+		static thread_local std::vector<std::size_t> missed;
+
+		const Connect4::Cell their_color = my_color == Connect4::Red ? Connect4::Black : Connect4::Red;
+
+		inputs.resize(n * input_size);
+		missed.clear();
+
+		for (std::size_t k = 0; k < n; ++k) {
+			const Connect4 &board = boards[indices[k]];
+
+			if (const Weight *cached = cache.find(tag, board.mask(my_color), board.mask(their_color))) {
+				moves[k] = connect4_choose(board, cached, output_size);
+			} else {
+				connect4_encode(board, my_color, &inputs[missed.size() * input_size]);
+				missed.push_back(k);
+			}
+		}
+
+		if (missed.empty()) {
+			return;
+		}
+
+		outputs.resize(missed.size() * output_size);
+
+		net.calculate_batch(inputs.data(), outputs.data(), missed.size(), neuralnet::sigmoid);
+
+		for (std::size_t m = 0; m < missed.size(); ++m) {
+			const Connect4 &board = boards[indices[missed[m]]];
+
+			std::uint32_t pieces = 0;
+
+			for (int x = 0; x < 8; ++x) {
+				pieces += board.height(x);
+			}
+
+			cache.insert(tag, board.mask(my_color), board.mask(their_color), pieces, &outputs[m * output_size]);
+
+			moves[missed[m]] = connect4_choose(board, &outputs[m * output_size], output_size);
+		}
+	};
+}
+
+// game i is played by nets[i]
+template <class NetT>
+auto connect4_each_player(const NetT *nets) {
+	return [nets](const Connect4 *boards, const std::size_t *indices, std::size_t n, Connect4::Cell my_color, int *moves) {
+		typename NetT::WeightT input[NetT::input_size()];
+		typename NetT::WeightT output[NetT::output_size()];
+
+		for (std::size_t k = 0; k < n; ++k) {
+			const Connect4 &board = boards[indices[k]];
+
+			connect4_encode(board, my_color, input);
+			nets[indices[k]].calculate(input, output, neuralnet::sigmoid);
+			moves[k] = connect4_choose(board, output, NetT::output_size());
+		}
+	};
+}
+
+template <class Weight>
+void turnbasedbattle_encode(turnbasedbattle::PlayerConstRef self, turnbasedbattle::PlayerConstRef enemy, Weight *input) {
+	namespace tb = turnbasedbattle;
+
+	input[0] = self.health;
+	input[1] = self.energy;
+	input[2] = self.lastAction == &tb::action_none ? 0.0f : self.lastAction - tb::actions + 1.0f;
+	input[3] = enemy.health;
+	input[4] = enemy.energy;
+	input[5] = enemy.lastAction == &tb::action_none ? 0.0f : enemy.lastAction - tb::actions + 1.0f;
+}
+
+// the highest scoring action the player can perform
+template <class Weight>
+const turnbasedbattle::Action &turnbasedbattle_choose(turnbasedbattle::PlayerConstRef self, turnbasedbattle::PlayerConstRef enemy, const Weight *output) {
+	namespace tb = turnbasedbattle;
+
+	std::size_t max_index = 0;
+
+	for (std::size_t i = 1; i < tb::array_size(tb::actions); ++i) {
+		if (output[i] > output[max_index] && tb::actions[i].predicate(self, enemy)) {
+			max_index = i;
+		}
+	}
+
+	return tb::actions[max_index];
+}
+
+template <class NetT>
+auto turnbasedbattle_player(const NetT &net) {
+	return [&net](turnbasedbattle::PlayerConstRef self, turnbasedbattle::PlayerConstRef enemy) -> const turnbasedbattle::Action & {
+		typename NetT::WeightT input[NetT::input_size()];
+		typename NetT::WeightT output[NetT::output_size()];
+
+		turnbasedbattle_encode(self, enemy, input);
+
+		net.calculate(input, output, neuralnet::sigmoid);
+
+		return turnbasedbattle_choose(self, enemy, output);
+	};
+}
+
+// one batched inference per move for all live games
+template <class NetT>
+auto turnbasedbattle_batch_player(const NetT &net) {
+	return [&net](const turnbasedbattle::Game *games, const std::size_t *indices, std::size_t n, int playerNum, const turnbasedbattle::Action **actions) {
+		static thread_local std::vector<typename NetT::WeightT> inputs, outputs;
+
+		inputs.resize(n * NetT::input_size());
+		outputs.resize(n * NetT::output_size());
+
+		for (std::size_t k = 0; k < n; ++k) {
+			const turnbasedbattle::Game &game = games[indices[k]];
+			turnbasedbattle_encode(game.players[playerNum], game.players[1 - playerNum], &inputs[k * NetT::input_size()]);
+		}
+
+		net.calculate_batch(inputs.data(), outputs.data(), n, neuralnet::sigmoid);
+
+		for (std::size_t k = 0; k < n; ++k) {
+			const turnbasedbattle::Game &game = games[indices[k]];
+			actions[k] = &turnbasedbattle_choose(game.players[playerNum], game.players[1 - playerNum], &outputs[k * NetT::output_size()]);
+		}
+	};
+}
+
+// game i is played by nets[i]
+template <class NetT>
+auto turnbasedbattle_each_player(const NetT *nets) {
+	return [nets](const turnbasedbattle::Game *games, const std::size_t *indices, std::size_t n, int playerNum, const turnbasedbattle::Action **actions) {
+		typename NetT::WeightT input[NetT::input_size()];
+		typename NetT::WeightT output[NetT::output_size()];
+
+		for (std::size_t k = 0; k < n; ++k) {
+			turnbasedbattle::PlayerConstRef self = games[indices[k]].players[playerNum];
+			turnbasedbattle::PlayerConstRef enemy = games[indices[k]].players[1 - playerNum];
+
+			turnbasedbattle_encode(self, enemy, input);
+			nets[indices[k]].calculate(input, output, neuralnet::sigmoid);
+			actions[k] = &turnbasedbattle_choose(self, enemy, output);
+		}
+	};
+}
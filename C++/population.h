@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <type_traits>
+#include <vector>
+
+#include "neuralnet.h"
+
+namespace neuralnet
+{
+	// a population of nets stored as shared dense bases plus, per individual, the sparse weights where it differs
+	// from its base. a child assigned with its parent and the indices mutate changed shares the parent's base,
+	// so a pool of related nets costs a few dense nets plus 6 or 8 bytes per changed weight.
+	// an individual whose delta outgrows maxDelta of the weights becomes a new base.
+	// reads and materialize are safe from several threads, assign and compact are not.
+	template <class NetT>
+	struct DeltaPopulation
+	{
+		typedef typename NetT::WeightT Weight;
+		typedef typename std::conditional<NetT::num_weights() <= 0x10000, std::uint16_t, std::uint32_t>::type Index;
+
+		// every individual starts as initial
+		explicit DeltaPopulation(std::size_t size, const NetT &initial = NetT()) :
+			bases(1, Base{initial, size}),
+			individuals(size)
+		{
+		}
+
+		std::size_t size() const {
+			return individuals.size();
+		}
+
+		// net = individual i
+		void materialize(std::size_t i, NetT &net) const {
+			const Individual &individual = individuals[i];
+
+			net = bases[individual.base].net;
+
+			Weight * const weights = net.weights();
+
+			for (std::size_t k = 0; k < individual.indices.size(); ++k) {
+				weights[individual.indices[k]] = individual.values[k];
+			}
+		}
+
+		// nets[k] = individual begin + k for k < end - begin, e.g. a chunk of opponents
+		void materialize(std::size_t begin, std::size_t end, NetT *nets) const {
+			for (std::size_t i = begin; i < end; ++i) {
+				materialize(i, nets[i - begin]);
+			}
+		}
+
+		// individual i = net, which differs from individual parent at most at the changed weight indices
+		// (as collected by mutate). costs O(changed + parent's delta), net's other weights are not read
+		void assign(std::size_t i, const NetT &net, std::size_t parent, const std::vector<std::uint32_t> &changed) {
+			const Individual &from = individuals[parent];
+
+			sorted.assign(changed.begin(), changed.end());
+			std::sort(sorted.begin(), sorted.end());
+
+			Individual child;
+
+			child.base = from.base;
+			child.indices.resize(from.indices.size() + sorted.size());
+			child.indices.erase(std::set_union(from.indices.begin(), from.indices.end(), sorted.begin(), sorted.end(), child.indices.begin()), child.indices.end());
+
+			set(i, net, child);
+		}
+
+		// individual i = net, stored against i's current base (compares every weight)
+		void assign(std::size_t i, const NetT &net) {
+			const std::size_t base = individuals[i].base;
+
+			const Weight * const weights = net.weights();
+			const Weight * const baseWeights = bases[base].net.weights();
+
+			Individual child;
+
+			child.base = base;
+
+			for (std::size_t k = 0; k < NetT::num_weights(); ++k) {
+				if (weights[k] != baseWeights[k]) {
+					child.indices.push_back(static_cast<Index>(k));
+				}
+			}
+
+			set(i, net, child);
+		}
+
+		// folds the delta of every individual that is alone on its base into the base,
+		// drops unused bases and releases spare capacity
+		void compact() {
+			for (Individual &individual : individuals) {
+				Base &base = bases[individual.base];
+
+				if (base.references == 1 && !individual.indices.empty()) {
+					Weight * const weights = base.net.weights();
+
+					for (std::size_t k = 0; k < individual.indices.size(); ++k) {
+						weights[individual.indices[k]] = individual.values[k];
+					}
+
+					individual.indices.clear();
+					individual.values.clear();
+				}
+
+				individual.indices.shrink_to_fit();
+				individual.values.shrink_to_fit();
+			}
+
+			std::vector<std::size_t> remap(bases.size());
+			std::size_t used = 0;
+
+			for (std::size_t b = 0; b < bases.size(); ++b) {
+				if (bases[b].references > 0) {
+					remap[b] = used;
+
+					if (used != b) {
+						bases[used] = bases[b];
+					}
+
+					++used;
+				}
+			}
+
+			bases.resize(used);
+			bases.shrink_to_fit();
+			freeBases.clear();
+
+			for (Individual &individual : individuals) {
+				individual.base = remap[individual.base];
+			}
+		}
+
+		std::size_t num_bases() const {
+			return bases.size() - freeBases.size();
+		}
+
+		// bytes held by the bases and the deltas (excluding allocator overhead)
+		std::size_t memory() const {
+			std::size_t bytes = bases.size() * sizeof(Base) + individuals.capacity() * sizeof(Individual);
+
+			for (const Individual &individual : individuals) {
+				bytes += individual.indices.capacity() * sizeof(Index) + individual.values.capacity() * sizeof(Weight);
+			}
+
+			return bytes;
+		}
+
+		// fraction of the weights a delta may hold before its individual becomes a base
+		double maxDelta = 0.25;
+
+	private:
+		struct Base
+		{
+			NetT net;
+			std::size_t references;
+		};
+
+		struct Individual
+		{
+			std::size_t base;
+			std::vector<Index> indices; // ascending
+			std::vector<Weight> values;
+		};
+
+		// stores child (base and indices chosen) as individual i, taking the values from net
+		void set(std::size_t i, const NetT &net, Individual &child) {
+			const Weight * const weights = net.weights();
+
+			if (child.indices.size() > maxDelta * NetT::num_weights()) {
+				child.indices = std::vector<Index>();
+				child.base = add_base(net);
+			} else {
+				child.values.resize(child.indices.size());
+
+				for (std::size_t k = 0; k < child.indices.size(); ++k) {
+					child.values[k] = weights[child.indices[k]];
+				}
+
+				++bases[child.base].references;
+			}
+
+			release(individuals[i].base);
+
+			individuals[i] = std::move(child);
+
+			// once most base slots are unused, give their memory back
+			if (freeBases.size() > bases.size() / 2) {
+				compact();
+			}
+		}
+
+		std::size_t add_base(const NetT &net) {
+			if (freeBases.empty()) {
+				bases.push_back(Base{net, 1});
+				return bases.size() - 1;
+			}
+
+			const std::size_t base = freeBases.back();
+
+			freeBases.pop_back();
+			bases[base].net = net;
+			bases[base].references = 1;
+
+			return base;
+		}
+
+		void release(std::size_t base) {
+			if (--bases[base].references == 0) {
+				freeBases.push_back(base);
+			}
+		}
+
+		std::deque<Base> bases; // a deque, so adding a base never moves the others
+		std::vector<std::size_t> freeBases;
+		std::vector<Individual> individuals;
+		std::vector<Index> sorted;
+	};
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "neuralnet.h"
+#include "simd.h"
+
+namespace neuralnet
+{
+	namespace detail
+	{
+		namespace quantized
+		{
+			// x in [-127, 127] rounded to nearest, branch free: adding 1.5 * 2^23 leaves round(x) in the low mantissa bits
+			inline std::int8_t round_code(float x) {
+				const float shifted = x + 12582912.0f;
+
+				std::int32_t bits;
+				std::memcpy(&bits, &shifted, sizeof(bits));
+
+				return static_cast<std::int8_t>(bits - 0x4B400000);
+			}
+
+			// 127 * sigmoid sampled on [-range, range], outside it the ends are used (sigmoid(8) is already code 127)
+			const std::size_t tableSize = 4096;
+			const float range = 8.0f;
+
+			struct SigmoidTable
+			{
+				std::int8_t codes[tableSize + 1]; // round(127 * sigmoid), the input code of the next layer
+
+				SigmoidTable() {
+					for (std::size_t i = 0; i <= tableSize; ++i) {
+						const double x = (2.0 * i / tableSize - 1) * range;
+						const double y = 1 / (1 + std::exp(-x));
+
+						codes[i] = round_code(static_cast<float>(127 * y));
+					}
+				}
+
+				// results[i] = the code of sigmoid(values[i]), values is overwritten.
+				// saturated neurons are common and unpredictable, so the clamp is a vector min / max rather than branches
+				void lookup(float *values, std::size_t size, std::int8_t *results) const {
+					simd::kernels().clamp(values, size, -range, range);
+
+					for (std::size_t i = 0; i < size; ++i) {
+						results[i] = codes[static_cast<int>((values[i] + range) * (tableSize / (2 * range)) + 0.5f)];
+					}
+				}
+			};
+
+			inline const SigmoidTable &sigmoid_table() {
+				static const SigmoidTable table;
+				return table;
+			}
+
+			// codes = round(values / scale) with scale = max |value| / 127, returns scale
+			inline float quantize(const float *values, std::size_t size, std::int8_t *codes) {
+				float max = 0;
+
+				for (std::size_t i = 0; i < size; ++i) {
+					const float magnitude = std::fabs(values[i]);
+					max = magnitude > max ? magnitude : max;
+				}
+
+				const float scale = max > 0 ? max / 127 : 1.0f;
+				const float inverse = 1 / scale;
+
+				for (std::size_t i = 0; i < size; ++i) {
+					codes[i] = round_code(values[i] * inverse);
+				}
+
+				return scale;
+			}
+		}
+	}
+
+	// post training int8 copy of a float Net for inference: a quarter of the weight memory and integer dot products.
+	// each layer's weights share one scale (max |weight| / 127), biases stay float. layer inputs are quantized the same
+	// way per call, except after a sigmoid, whose table directly gives the codes of (0, 1) at scale 1 / 127.
+	// the activation is always sigmoid: hidden layers look their codes up in a table, the outputs use the float kernel,
+	// so outputs saturating the table cannot tie. the first hidden layer is not activated, as in Net.
+	template <std::size_t depth, std::size_t size, std::size_t outputSize>
+	struct QuantizedNet
+	{
+		// rows padded to whole 16 byte vectors
+		static const std::size_t stride = (size + 15) / 16 * 16;
+
+		template <template <class, std::size_t, std::size_t> class LayerTemplate>
+		explicit QuantizedNet(const Net<float, depth, size, outputSize, LayerTemplate> &net) : hiddenWeights(), outputWeights() {
+			for (std::size_t l = 0; l < depth; ++l) {
+				hiddenScales[l] = quantize_layer(net.hiddenLayers[l], size, hiddenWeights[l][0], hiddenBiases[l]);
+			}
+
+			outputScale = quantize_layer(net.outputLayer, outputSize, outputWeights[0], outputBiases);
+		}
+
+		static constexpr std::size_t input_size() {
+			return size;
+		}
+
+		static constexpr std::size_t output_size() {
+			return outputSize;
+		}
+
+		void calculate(const float *inputs, float *outputs) const {
+			const detail::quantized::SigmoidTable &table = detail::quantized::sigmoid_table();
+
+			alignas(16) std::int8_t codes[stride] = {};
+			float values[size];
+			std::int32_t sums[size > outputSize ? size : outputSize];
+
+			float scale = detail::quantized::quantize(inputs, size, codes);
+
+			for (std::size_t l = 0; l < depth; ++l) {
+				simd::kernels().layer_i8(hiddenWeights[l][0], stride, size, stride, codes, sums);
+
+				const float factor = hiddenScales[l] * scale;
+
+				if (l == 0) {
+					for (std::size_t i = 0; i < size; ++i) {
+						values[i] = sums[i] * factor - hiddenBiases[l][i];
+					}
+
+					scale = detail::quantized::quantize(values, size, codes);
+				} else {
+					for (std::size_t i = 0; i < size; ++i) {
+						values[i] = sums[i] * factor - hiddenBiases[l][i];
+					}
+
+					table.lookup(values, size, codes);
+
+					scale = 1.0f / 127;
+				}
+			}
+
+			simd::kernels().layer_i8(outputWeights[0], stride, outputSize, stride, codes, sums);
+
+			const float factor = outputScale * scale;
+
+			for (std::size_t i = 0; i < outputSize; ++i) {
+				outputs[i] = sums[i] * factor - outputBiases[i];
+			}
+
+			detail::activate(sigmoid, outputs, outputs + outputSize);
+		}
+
+		alignas(16) std::int8_t hiddenWeights[depth][size][stride];
+		alignas(16) std::int8_t outputWeights[outputSize][stride];
+		float hiddenBiases[depth][size];
+		float outputBiases[outputSize];
+		float hiddenScales[depth];
+		float outputScale;
+
+	private:
+		// fills count rows of weights (zero padded to stride) and the biases, returns the weight scale
+		template <class LayerT>
+		static float quantize_layer(const LayerT &layer, std::size_t count, std::int8_t *weights, float *biases) {
+			float max = 0;
+
+			for (std::size_t i = 0; i < count; ++i) {
+				for (std::size_t j = 0; j < size; ++j) {
+					max = std::fmax(max, std::fabs(layer.row(i)[j]));
+				}
+
+				biases[i] = layer.bias(i);
+			}
+
+			const float scale = max > 0 ? max / 127 : 1.0f;
+
+			for (std::size_t i = 0; i < count; ++i) {
+				for (std::size_t j = 0; j < size; ++j) {
+					weights[i * stride + j] = detail::quantized::round_code(layer.row(i)[j] / scale);
+				}
+			}
+
+			return scale;
+		}
+	};
+
+	// fraction of count rows of inputs (each net.input_size() floats) on which the float net with sigmoid and the
+	// quantized net have their largest output at the same index
+	template <class NetT, std::size_t depth, std::size_t size, std::size_t outputSize>
+	double argmax_agreement(const NetT &net, const QuantizedNet<depth, size, outputSize> &quantized, const float *inputs, std::size_t count) {
+		std::size_t agreed = 0;
+
+		for (std::size_t r = 0; r < count; ++r) {
+			const float (&input)[size] = *reinterpret_cast<const float (*)[size]>(inputs + r * size);
+
+			float expected[outputSize], actual[outputSize];
+
+			net.calculate(input, expected, sigmoid);
+			quantized.calculate(inputs + r * size, actual);
+
+			std::size_t e = 0, a = 0;
+
+			for (std::size_t i = 1; i < outputSize; ++i) {
+				e = expected[i] > expected[e] ? i : e;
+				a = actual[i] > actual[a] ? i : a;
+			}
+
+			agreed += e == a ? 1 : 0;
+		}
+
+		return count > 0 ? static_cast<double>(agreed) / count : 1.0;
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+namespace neuralnet
+{
+	// counter based generator: output n of a stream is the splitmix64 mix of key + (n + 1) * gamma.
+	// seeding a stream is O(1), skipping ahead is O(1) and bulk fills are independent iterations
+	// the compiler can vectorize. streams are (seed, stream) pairs, e.g. (run, worker) or (run, individual),
+	// so parallel code draws reproducible numbers without sharing state.
+	struct CounterRng
+	{
+		typedef std::uint64_t result_type;
+
+		static const std::uint64_t gamma = 0x9E3779B97F4A7C15ull;
+
+		static constexpr result_type min() {
+			return 0;
+		}
+
+		static constexpr result_type max() {
+			return std::numeric_limits<result_type>::max();
+		}
+
+		static std::uint64_t mix(std::uint64_t z) {
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+
+		explicit CounterRng(std::uint64_t seed = 0, std::uint64_t stream = 0) {
+			this->seed(seed, stream);
+		}
+
+		void seed(std::uint64_t seed, std::uint64_t stream = 0) {
+			key = mix(seed + gamma) ^ mix(mix(stream) + 2 * gamma);
+			counter = 0;
+		}
+
+		result_type at(std::uint64_t n) const {
+			return mix(key + (n + 1) * gamma);
+		}
+
+		result_type operator()() {
+			return at(counter++);
+		}
+
+		void discard(std::uint64_t n) {
+			counter += n;
+		}
+
+		// values[i] = uniform in [0, 1), same sequence as size calls to unit<T>(rng())
+		template <class T>
+		void fill_uniform(T *values, std::size_t size) {
+			const std::uint64_t begin = counter;
+
+			for (std::size_t i = 0; i < size; ++i) {
+				values[i] = unit<T>(at(begin + i));
+			}
+
+			counter += size;
+		}
+
+		// top mantissa-width bits of value scaled to [0, 1)
+		template <class T>
+		static T unit(std::uint64_t value) {
+			return unit(value, static_cast<T *>(nullptr));
+		}
+
+	private:
+		static float unit(std::uint64_t value, float *) {
+			return static_cast<float>(static_cast<std::int32_t>(value >> 40)) * (1.0f / 16777216.0f);
+		}
+
+		template <class T>
+		static T unit(std::uint64_t value, T *) {
+			return static_cast<T>(static_cast<double>(static_cast<std::int64_t>(value >> 11)) * (1.0 / 9007199254740992.0));
+		}
+
+		std::uint64_t key;
+		std::uint64_t counter;
+	};
+
+	namespace detail
+	{
+		namespace random
+		{
+			// nondeterministic per process, like the old global engine
+			inline std::uint64_t process_seed() {
+				static const std::uint64_t seed = [] {
+					std::random_device device;
+					return (static_cast<std::uint64_t>(device()) << 32) ^ device();
+				}();
+
+				return seed;
+			}
+
+			inline std::uint64_t next_thread_stream() {
+				static std::atomic<std::uint64_t> streams(0);
+				return streams++;
+			}
+
+			// each thread owns its generator, so randf is safe inside parallel regions
+			inline CounterRng &generator() {
+				static thread_local CounterRng rng(process_seed(), next_thread_stream());
+				return rng;
+			}
+
+			inline std::uint64_t next() {
+				return generator()();
+			}
+		}
+	}
+
+	// reseeds the calling thread's generator, e.g. seed_random(runSeed, individual) before mutating
+	// an individual makes its mutation replayable regardless of which thread performs it
+	inline void seed_random(std::uint64_t seed, std::uint64_t stream = 0) {
+		detail::random::generator().seed(seed, stream);
+	}
+
+	// fills values with uniforms in [0, 1) from the calling thread's generator
+	template <class T>
+	void fill_uniform(T *values, std::size_t size) {
+		detail::random::generator().fill_uniform(values, size);
+	}
+}
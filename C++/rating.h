@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "random.h"
+
+namespace neuralnet
+{
+	// Elo ratings of a pool of contenders, updated incrementally from the games they play against candidates.
+	// a candidate is rated by its performance (the rating expecting the points it scored against its opponents)
+	// and each opponent then moves by k times its surprise against that rating. the surprises of one candidate's
+	// games sum to zero, so only admissions move the pool's mean rating, as long as a perfect or nil score (which has
+	// no finite performance to be surprised against, see performance) updates no opponent.
+	struct EloRatings
+	{
+		explicit EloRatings(std::size_t size, double initial = 1500) : ratings(size, initial), games(size, 0) {}
+
+		std::size_t size() const {
+			return ratings.size();
+		}
+
+		// expected points of a against b per game, a win is 1
+		static double expected(double a, double b) {
+			return 1 / (1 + std::pow(10.0, (b - a) / 400));
+		}
+
+		// the rating advantage expected to score rate in (0, 1), e.g. 84 for 0.618
+		static double margin(double rate) {
+			return 400 * std::log10(rate / (1 - rate));
+		}
+
+		double mean() const {
+			return ratings.empty() ? 0 : std::accumulate(ratings.begin(), ratings.end(), 0.0) / ratings.size();
+		}
+
+		// the rating scoring points in gamesEach games against each of count opponents.
+		// a perfect or nil score, which no finite rating scores, is capped 400 beyond the strongest or weakest opponent
+		double performance(const std::size_t *opponents, std::size_t count, int gamesEach, double points) const {
+			if (count == 0) {
+				return mean();
+			}
+
+			double low = ratings[opponents[0]], high = low;
+
+			for (std::size_t i = 1; i < count; ++i) {
+				low = std::min(low, ratings[opponents[i]]);
+				high = std::max(high, ratings[opponents[i]]);
+			}
+
+			low -= 400;
+			high += 400;
+
+			// as q = 10^(rating / 400) relative to base, the expected points of q against qi are q / (q + qi)
+			const double base = low;
+
+			std::vector<double> strengths(count);
+
+			for (std::size_t i = 0; i < count; ++i) {
+				strengths[i] = std::pow(10.0, (ratings[opponents[i]] - base) / 400);
+			}
+
+			auto expectedPoints = [&](double rating) {
+				const double strength = std::pow(10.0, (rating - base) / 400);
+
+				double sum = 0;
+
+				for (std::size_t i = 0; i < count; ++i) {
+					sum += strength / (strength + strengths[i]);
+				}
+
+				return gamesEach * sum;
+			};
+
+			// any other score lies within the bounds once they are wide enough, e.g. 99 of 100 games
+			// against one opponent is a performance 800 above it
+			if (points > 0 && points < static_cast<double>(gamesEach) * count) {
+				while (expectedPoints(high) < points) {
+					high += 400;
+				}
+
+				while (expectedPoints(low) > points) {
+					low -= 400;
+				}
+			}
+
+			// the expected points only grow with the rating
+			for (int iteration = 0; iteration < 40; ++iteration) {
+				const double middle = (low + high) / 2;
+
+				if (expectedPoints(middle) < points) {
+					low = middle;
+				} else {
+					high = middle;
+				}
+			}
+
+			return (low + high) / 2;
+		}
+
+		// contender i scored points in numGames games against a player rated rating
+		void update(std::size_t i, int numGames, double points, double rating) {
+			ratings[i] += k * (points - numGames * expected(ratings[i], rating));
+			games[i] += numGames;
+		}
+
+		// contender i was replaced by a player rated rating
+		void reset(std::size_t i, double rating) {
+			ratings[i] = rating;
+			games[i] = 0;
+		}
+
+		// one contender from each of count equally sized strata of the pool sorted by rating, ascending,
+		// so a sample plays the whole range of the pool. all contenders if count >= size()
+		void sample(std::size_t count, CounterRng &rng, std::vector<std::size_t> &indices) {
+			const std::size_t n = ratings.size();
+
+			count = std::min(count, n);
+
+			sort_by_rating();
+
+			indices.resize(count);
+
+			for (std::size_t s = 0; s < count; ++s) {
+				const std::size_t begin = s * n / count, end = (s + 1) * n / count;
+
+				indices[s] = order[begin + static_cast<std::size_t>(rng() % (end - begin))];
+			}
+		}
+
+		// appends the ratings to bytes, e.g. for the extra bytes of a checkpoint
+		void write(std::vector<unsigned char> &bytes) const {
+			const std::uint64_t count = ratings.size();
+
+			const std::size_t offset = bytes.size();
+
+			bytes.resize(offset + sizeof(count) + count * (sizeof(double) + sizeof(std::uint32_t)));
+
+			unsigned char *out = &bytes[offset];
+
+			std::memcpy(out, &count, sizeof(count));
+			std::memcpy(out + sizeof(count), ratings.data(), count * sizeof(double));
+			std::memcpy(out + sizeof(count) + count * sizeof(double), games.data(), count * sizeof(std::uint32_t));
+		}
+
+		// fails, leaving the ratings unchanged, unless the size bytes at in hold as many ratings as written by write
+		bool read(const unsigned char *in, std::size_t size) {
+			std::uint64_t count = 0;
+
+			if (size < sizeof(count)) {
+				return false;
+			}
+
+			std::memcpy(&count, in, sizeof(count));
+
+			if (count != ratings.size() || size != sizeof(count) + count * (sizeof(double) + sizeof(std::uint32_t))) {
+				return false;
+			}
+
+			std::memcpy(ratings.data(), in + sizeof(count), count * sizeof(double));
+			std::memcpy(games.data(), in + sizeof(count) + count * sizeof(double), count * sizeof(std::uint32_t));
+
+			return true;
+		}
+
+		// rating points moved per point of surprise
+		double k = 16;
+
+		std::vector<double> ratings;
+		std::vector<std::uint32_t> games; // played since the contender entered the pool
+
+	private:
+		// order = the contenders by rating, ties by index, radix sorted on the bits of the ratings: exact like a full
+		// sort, which would cost more than the games for large pools, in linear time. the sort is stable, so a sample
+		// replays exactly
+		void sort_by_rating() {
+			const std::size_t n = ratings.size();
+
+			keyed.resize(n);
+			scratch.resize(n);
+
+			// 11 bit digits, all counted in one pass over the ratings
+			starts.assign(numDigits * 2049, 0);
+
+			for (std::size_t i = 0; i < n; ++i) {
+				std::uint64_t bits;
+				std::memcpy(&bits, &ratings[i], sizeof(bits));
+
+				// ordered as unsigned integers like the doubles: negatives flipped, positives above them
+				keyed[i].first = bits >> 63 ? ~bits : bits | (1ull << 63);
+				keyed[i].second = i;
+
+				for (std::size_t digit = 0; digit < numDigits; ++digit) {
+					++starts[digit * 2049 + ((keyed[i].first >> (11 * digit)) & 0x7FF) + 1];
+				}
+			}
+
+			// skipping the digits all ratings share (usually the sign and exponent)
+			for (std::size_t digit = 0; digit < numDigits && n > 0; ++digit) {
+				const std::size_t shift = 11 * digit;
+				std::size_t *digitStarts = &starts[digit * 2049];
+
+				if (digitStarts[((keyed[0].first >> shift) & 0x7FF) + 1] == n) {
+					continue;
+				}
+
+				for (std::size_t d = 0; d < 2048; ++d) {
+					digitStarts[d + 1] += digitStarts[d];
+				}
+
+				for (const auto &entry : keyed) {
+					scratch[digitStarts[(entry.first >> shift) & 0x7FF]++] = entry;
+				}
+
+				keyed.swap(scratch);
+			}
+
+			order.resize(n);
+
+			for (std::size_t i = 0; i < n; ++i) {
+				order[i] = keyed[i].second;
+			}
+		}
+
+		static const std::size_t numDigits = 6;
+
+		std::vector<std::size_t> order, starts;
+		std::vector<std::pair<std::uint64_t, std::size_t>> keyed, scratch; // (sort key, contender)
+	};
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include "neuralnet.h"
+
+namespace neuralnet
+{
+	// Elman net: each step the recurrent layer sees the inputs followed by the previous state and
+	// its activated outputs become the new state, which the output layer reads.
+	// the caller owns the state (zeroed for a new sequence), so one net can run any number of sequences
+	// and a step only uses the stack. unlike Net, the recurrent layer is always activated, which keeps the state bounded.
+	template <class Weight, std::size_t inputSize, std::size_t stateSize, std::size_t outputSize, template <class, std::size_t, std::size_t> class LayerTemplate = Layer>
+	struct RecurrentNet : FeedForwardNet<RecurrentNet<Weight, inputSize, stateSize, outputSize, LayerTemplate>, Weight>
+	{
+		typedef LayerTemplate<Weight, stateSize, inputSize + stateSize> RecurrentLayerT;
+		typedef LayerTemplate<Weight, outputSize, stateSize> OutputLayerT;
+
+		typedef Weight StateT[stateSize];
+
+		RecurrentLayerT recurrentLayer;
+		OutputLayerT outputLayer;
+
+		static constexpr std::size_t input_size() {
+			return inputSize;
+		}
+
+		static constexpr std::size_t state_size() {
+			return stateSize;
+		}
+
+		static constexpr std::size_t output_size() {
+			return outputSize;
+		}
+
+		static constexpr std::size_t num_hidden_layers() {
+			return 1;
+		}
+
+		// the whole net viewed as one array, in update order
+		static constexpr std::size_t num_weights() {
+			return sizeof(RecurrentLayerT) / sizeof(Weight) + sizeof(OutputLayerT) / sizeof(Weight);
+		}
+
+		Weight *weights() {
+			return reinterpret_cast<Weight *>(&recurrentLayer);
+		}
+
+		const Weight *weights() const {
+			return reinterpret_cast<const Weight *>(&recurrentLayer);
+		}
+
+		template <class Func>
+		void update(Func func) {
+			recurrentLayer.update(func);
+			outputLayer.update(func);
+		}
+
+		// advances state by one input and writes the outputs
+		template <class Activator>
+		void step(const Weight (&inputs)[inputSize], StateT &state, Weight (&outputs)[outputSize], Activator activator) const
+		{
+			Weight combined[inputSize + stateSize];
+
+			std::copy(inputs, inputs + inputSize, combined);
+			std::copy(state, state + stateSize, combined + inputSize);
+
+			recurrentLayer.calculate(combined, state, activator);
+			outputLayer.calculate(state, outputs, activator);
+		}
+
+		// max rows per tile in step_batch, bounds the stack used for the combined inputs
+		static const std::size_t batchTile = 32;
+
+		// step for count sequences at once: count rows of inputSize inputs, stateSize states (advanced in place)
+		// and outputSize outputs. each layer runs as one matrix-matrix product per tile.
+		template <class Activator>
+		void step_batch(const Weight *inputs, Weight *states, Weight *outputs, std::size_t count, Activator activator) const
+		{
+			const std::size_t width = inputSize + stateSize;
+
+			Weight combined[batchTile * width];
+
+			for (std::size_t begin = 0; begin < count; begin += batchTile) {
+				const std::size_t rows = count - begin < batchTile ? count - begin : batchTile;
+
+				Weight * const tileStates = states + begin * stateSize;
+
+				for (std::size_t r = 0; r < rows; ++r) {
+					const Weight * const in = inputs + (begin + r) * inputSize;
+
+					std::copy(in, in + inputSize, combined + r * width);
+					std::copy(tileStates + r * stateSize, tileStates + (r + 1) * stateSize, combined + r * width + inputSize);
+				}
+
+				recurrentLayer.calculate_batch(combined, tileStates, rows, activator);
+				outputLayer.calculate_batch(tileStates, outputs + begin * outputSize, rows, activator);
+			}
+		}
+	};
+}
@@ -0,0 +1,740 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define NEURALNET_SIMD_X86 1
+	#include <immintrin.h>
+#endif
+
+// explicit vector kernels for float layers, the best kernel set is picked once from cpuid.
+// neuron i of a layer has n weights at weights + i * stride and its bias at biases[i * biasStride].
+namespace neuralnet
+{
+	namespace simd
+	{
+		enum Isa {
+			Scalar,
+			SSE2,
+			AVX2,
+			AVX512
+		};
+
+		inline const char *IsaToString(Isa isa) {
+			switch (isa) {
+			case Scalar: return "Scalar";
+			case SSE2: return "SSE2";
+			case AVX2: return "AVX2";
+			case AVX512: return "AVX512";
+			default: return "Unknown";
+			}
+		}
+
+		struct Kernels
+		{
+			Isa isa;
+
+			// outputs[i] = dot(neuron i, inputs) - bias i
+			void (*layer)(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs);
+
+			// same as layer, for rows inputs (rows * n) producing rows outputs (rows * count)
+			void (*layer_batch)(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs, std::size_t rows);
+
+			// values[i] = 1 / (1 + exp(-values[i]))
+			void (*sigmoid)(float *values, std::size_t size);
+
+			// values[i] = min(max(values[i], lo), hi), without the branches compilers emit for the scalar form
+			void (*clamp)(float *values, std::size_t size, float lo, float hi);
+
+			// outputs[i] = dot(row i, inputs) for int8 rows, accumulated in int32. quantized nets use it.
+			void (*layer_i8)(const std::int8_t *weights, std::size_t stride, std::size_t count, std::size_t n, const std::int8_t *inputs, std::int32_t *outputs);
+		};
+
+		namespace detail
+		{
+			inline void layer_scalar(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs) {
+				for (std::size_t i = 0; i < count; ++i) {
+					const float *row = weights + i * stride;
+					const float bias = biases[i * biasStride];
+
+					float result = -bias;
+
+					for (std::size_t j = 0; j < n; ++j) {
+						result += inputs[j] * row[j];
+					}
+
+					outputs[i] = result;
+				}
+			}
+
+			inline void layer_batch_scalar(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs, std::size_t rows) {
+				for (std::size_t r = 0; r < rows; ++r) {
+					layer_scalar(weights, stride, biases, biasStride, count, n, inputs + r * n, outputs + r * count);
+				}
+			}
+
+			inline void sigmoid_scalar(float *values, std::size_t size) {
+				for (std::size_t i = 0; i < size; ++i) {
+					values[i] = 1 / (1 + std::exp(-values[i]));
+				}
+			}
+
+			inline void clamp_scalar(float *values, std::size_t size, float lo, float hi) {
+				for (std::size_t i = 0; i < size; ++i) {
+					values[i] = values[i] < lo ? lo : values[i] > hi ? hi : values[i];
+				}
+			}
+
+			inline std::int32_t dot_i8_scalar(const std::int8_t *a, const std::int8_t *b, std::size_t n) {
+				std::int32_t result = 0;
+
+				for (std::size_t j = 0; j < n; ++j) {
+					result += static_cast<std::int32_t>(a[j]) * b[j];
+				}
+
+				return result;
+			}
+
+			inline void layer_i8_scalar(const std::int8_t *weights, std::size_t stride, std::size_t count, std::size_t n, const std::int8_t *inputs, std::int32_t *outputs) {
+				for (std::size_t i = 0; i < count; ++i) {
+					outputs[i] = dot_i8_scalar(weights + i * stride, inputs, n);
+				}
+			}
+
+#ifdef NEURALNET_SIMD_X86
+			// exp coefficients (cephes expf), the clamp keeps 2^n a normal float
+			const float expMax = 88.0f;
+			const float expMin = -87.0f;
+			const float log2e = 1.44269504088896341f;
+			const float ln2Hi = 0.693359375f;
+			const float ln2Lo = -2.12194440e-4f;
+			const float expP0 = 1.9875691500e-4f;
+			const float expP1 = 1.3981999507e-3f;
+			const float expP2 = 8.3334519073e-3f;
+			const float expP3 = 4.1665795894e-2f;
+			const float expP4 = 1.6666665459e-1f;
+			const float expP5 = 5.0000001201e-1f;
+
+			// SSE2
+
+			__attribute__((target("sse2")))
+			inline float hsum_sse2(__m128 v) {
+				v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+				v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+				return _mm_cvtss_f32(v);
+			}
+
+			__attribute__((target("sse2")))
+			inline __m128 exp_sse2(__m128 x) {
+				x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(expMin)), _mm_set1_ps(expMax));
+
+				const __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(log2e)));
+				const __m128 fn = _mm_cvtepi32_ps(n);
+
+				x = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(ln2Hi)));
+				x = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(ln2Lo)));
+
+				__m128 p = _mm_set1_ps(expP0);
+				p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(expP1));
+				p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(expP2));
+				p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(expP3));
+				p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(expP4));
+				p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(expP5));
+				p = _mm_add_ps(_mm_mul_ps(p, _mm_mul_ps(x, x)), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+
+				const __m128i scale = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+
+				return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+			}
+
+			__attribute__((target("sse2")))
+			inline float dot_sse2(const float *a, const float *b, std::size_t n) {
+				__m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+
+				std::size_t j = 0;
+
+				for (; j + 8 <= n; j += 8) {
+					acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + j), _mm_loadu_ps(b + j)));
+					acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + j + 4), _mm_loadu_ps(b + j + 4)));
+				}
+
+				for (; j + 4 <= n; j += 4) {
+					acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + j), _mm_loadu_ps(b + j)));
+				}
+
+				float result = hsum_sse2(_mm_add_ps(acc0, acc1));
+
+				for (; j < n; ++j) {
+					result += a[j] * b[j];
+				}
+
+				return result;
+			}
+
+			// four neurons at a time share each input load and give four independent add chains
+			__attribute__((target("sse2")))
+			inline void layer_sse2(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs) {
+				std::size_t i = 0;
+
+				for (; i + 4 <= count; i += 4) {
+					const float *w0 = weights + i * stride, *w1 = w0 + stride, *w2 = w1 + stride, *w3 = w2 + stride;
+
+					__m128 acc0 = _mm_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+					std::size_t j = 0;
+
+					for (; j + 4 <= n; j += 4) {
+						const __m128 x = _mm_loadu_ps(inputs + j);
+
+						acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(w0 + j), x));
+						acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(w1 + j), x));
+						acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(w2 + j), x));
+						acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(w3 + j), x));
+					}
+
+					float r0 = hsum_sse2(acc0), r1 = hsum_sse2(acc1), r2 = hsum_sse2(acc2), r3 = hsum_sse2(acc3);
+
+					for (; j < n; ++j) {
+						r0 += w0[j] * inputs[j];
+						r1 += w1[j] * inputs[j];
+						r2 += w2[j] * inputs[j];
+						r3 += w3[j] * inputs[j];
+					}
+
+					outputs[i] = r0 - biases[i * biasStride];
+					outputs[i + 1] = r1 - biases[(i + 1) * biasStride];
+					outputs[i + 2] = r2 - biases[(i + 2) * biasStride];
+					outputs[i + 3] = r3 - biases[(i + 3) * biasStride];
+				}
+
+				for (; i < count; ++i) {
+					outputs[i] = dot_sse2(weights + i * stride, inputs, n) - biases[i * biasStride];
+				}
+			}
+
+			__attribute__((target("sse2")))
+			inline void layer_batch_sse2(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs, std::size_t rows) {
+				std::size_t r = 0;
+
+				for (; r + 4 <= rows; r += 4) {
+					const float *in = inputs + r * n;
+					float *out = outputs + r * count;
+
+					for (std::size_t i = 0; i < count; ++i) {
+						const float *row = weights + i * stride;
+						const float bias = biases[i * biasStride];
+
+						__m128 acc0 = _mm_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+						std::size_t j = 0;
+
+						for (; j + 4 <= n; j += 4) {
+							const __m128 w = _mm_loadu_ps(row + j);
+
+							acc0 = _mm_add_ps(acc0, _mm_mul_ps(w, _mm_loadu_ps(in + j)));
+							acc1 = _mm_add_ps(acc1, _mm_mul_ps(w, _mm_loadu_ps(in + n + j)));
+							acc2 = _mm_add_ps(acc2, _mm_mul_ps(w, _mm_loadu_ps(in + 2 * n + j)));
+							acc3 = _mm_add_ps(acc3, _mm_mul_ps(w, _mm_loadu_ps(in + 3 * n + j)));
+						}
+
+						float r0 = hsum_sse2(acc0), r1 = hsum_sse2(acc1), r2 = hsum_sse2(acc2), r3 = hsum_sse2(acc3);
+
+						for (; j < n; ++j) {
+							r0 += row[j] * in[j];
+							r1 += row[j] * in[n + j];
+							r2 += row[j] * in[2 * n + j];
+							r3 += row[j] * in[3 * n + j];
+						}
+
+						out[i] = r0 - bias;
+						out[count + i] = r1 - bias;
+						out[2 * count + i] = r2 - bias;
+						out[3 * count + i] = r3 - bias;
+					}
+				}
+
+				for (; r < rows; ++r) {
+					layer_sse2(weights, stride, biases, biasStride, count, n, inputs + r * n, outputs + r * count);
+				}
+			}
+
+			__attribute__((target("sse2")))
+			inline void sigmoid_sse2(float *values, std::size_t size) {
+				const __m128 one = _mm_set1_ps(1.0f);
+
+				std::size_t i = 0;
+
+				for (; i + 4 <= size; i += 4) {
+					const __m128 x = _mm_loadu_ps(values + i);
+					_mm_storeu_ps(values + i, _mm_div_ps(one, _mm_add_ps(one, exp_sse2(_mm_sub_ps(_mm_setzero_ps(), x)))));
+				}
+
+				sigmoid_scalar(values + i, size - i);
+			}
+
+			__attribute__((target("sse2")))
+			inline void clamp_sse2(float *values, std::size_t size, float lo, float hi) {
+				const __m128 low = _mm_set1_ps(lo), high = _mm_set1_ps(hi);
+
+				std::size_t i = 0;
+
+				for (; i + 4 <= size; i += 4) {
+					_mm_storeu_ps(values + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(values + i), low), high));
+				}
+
+				clamp_scalar(values + i, size - i, lo, hi);
+			}
+
+			__attribute__((target("sse2")))
+			inline std::int32_t hsum_epi32_sse2(__m128i v) {
+				v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+				v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+				return _mm_cvtsi128_si32(v);
+			}
+
+			// 16 int8 products per step: sign extend both halves to int16, then multiply-add pairs into int32
+			__attribute__((target("sse2")))
+			inline std::int32_t dot_i8_sse2(const std::int8_t *a, const std::int8_t *b, std::size_t n) {
+				__m128i acc = _mm_setzero_si128();
+
+				std::size_t j = 0;
+
+				for (; j + 16 <= n; j += 16) {
+					const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + j));
+					const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+
+					const __m128i xLo = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8), xHi = _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+					const __m128i yLo = _mm_srai_epi16(_mm_unpacklo_epi8(y, y), 8), yHi = _mm_srai_epi16(_mm_unpackhi_epi8(y, y), 8);
+
+					acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(xLo, yLo), _mm_madd_epi16(xHi, yHi)));
+				}
+
+				return hsum_epi32_sse2(acc) + dot_i8_scalar(a + j, b + j, n - j);
+			}
+
+			__attribute__((target("sse2")))
+			inline void layer_i8_sse2(const std::int8_t *weights, std::size_t stride, std::size_t count, std::size_t n, const std::int8_t *inputs, std::int32_t *outputs) {
+				for (std::size_t i = 0; i < count; ++i) {
+					outputs[i] = dot_i8_sse2(weights + i * stride, inputs, n);
+				}
+			}
+
+			// AVX2 + FMA
+
+			__attribute__((target("avx2,fma")))
+			inline float hsum_avx2(__m256 v) {
+				__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+				s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+				s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+				return _mm_cvtss_f32(s);
+			}
+
+			__attribute__((target("avx2,fma")))
+			inline __m256 exp_avx2(__m256 x) {
+				x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(expMin)), _mm256_set1_ps(expMax));
+
+				const __m256 fn = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+				x = _mm256_fnmadd_ps(fn, _mm256_set1_ps(ln2Hi), x);
+				x = _mm256_fnmadd_ps(fn, _mm256_set1_ps(ln2Lo), x);
+
+				__m256 p = _mm256_set1_ps(expP0);
+				p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(expP1));
+				p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(expP2));
+				p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(expP3));
+				p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(expP4));
+				p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(expP5));
+				p = _mm256_fmadd_ps(p, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+				const __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(fn), _mm256_set1_epi32(127)), 23);
+
+				return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+			}
+
+			__attribute__((target("avx2,fma")))
+			inline float dot_avx2(const float *a, const float *b, std::size_t n) {
+				__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+
+				std::size_t j = 0;
+
+				for (; j + 16 <= n; j += 16) {
+					acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j), acc0);
+					acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j + 8), _mm256_loadu_ps(b + j + 8), acc1);
+				}
+
+				for (; j + 8 <= n; j += 8) {
+					acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j), acc0);
+				}
+
+				float result = hsum_avx2(_mm256_add_ps(acc0, acc1));
+
+				for (; j < n; ++j) {
+					result += a[j] * b[j];
+				}
+
+				return result;
+			}
+
+			__attribute__((target("avx2,fma")))
+			inline void layer_avx2(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs) {
+				std::size_t i = 0;
+
+				for (; i + 4 <= count; i += 4) {
+					const float *w0 = weights + i * stride, *w1 = w0 + stride, *w2 = w1 + stride, *w3 = w2 + stride;
+
+					__m256 acc0 = _mm256_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+					std::size_t j = 0;
+
+					for (; j + 8 <= n; j += 8) {
+						const __m256 x = _mm256_loadu_ps(inputs + j);
+
+						acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(w0 + j), x, acc0);
+						acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(w1 + j), x, acc1);
+						acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(w2 + j), x, acc2);
+						acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(w3 + j), x, acc3);
+					}
+
+					float r0 = hsum_avx2(acc0), r1 = hsum_avx2(acc1), r2 = hsum_avx2(acc2), r3 = hsum_avx2(acc3);
+
+					for (; j < n; ++j) {
+						r0 += w0[j] * inputs[j];
+						r1 += w1[j] * inputs[j];
+						r2 += w2[j] * inputs[j];
+						r3 += w3[j] * inputs[j];
+					}
+
+					outputs[i] = r0 - biases[i * biasStride];
+					outputs[i + 1] = r1 - biases[(i + 1) * biasStride];
+					outputs[i + 2] = r2 - biases[(i + 2) * biasStride];
+					outputs[i + 3] = r3 - biases[(i + 3) * biasStride];
+				}
+
+				for (; i < count; ++i) {
+					outputs[i] = dot_avx2(weights + i * stride, inputs, n) - biases[i * biasStride];
+				}
+			}
+
+			__attribute__((target("avx2,fma")))
+			inline void layer_batch_avx2(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs, std::size_t rows) {
+				std::size_t r = 0;
+
+				for (; r + 4 <= rows; r += 4) {
+					const float *in = inputs + r * n;
+					float *out = outputs + r * count;
+
+					for (std::size_t i = 0; i < count; ++i) {
+						const float *row = weights + i * stride;
+						const float bias = biases[i * biasStride];
+
+						__m256 acc0 = _mm256_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+						std::size_t j = 0;
+
+						for (; j + 8 <= n; j += 8) {
+							const __m256 w = _mm256_loadu_ps(row + j);
+
+							acc0 = _mm256_fmadd_ps(w, _mm256_loadu_ps(in + j), acc0);
+							acc1 = _mm256_fmadd_ps(w, _mm256_loadu_ps(in + n + j), acc1);
+							acc2 = _mm256_fmadd_ps(w, _mm256_loadu_ps(in + 2 * n + j), acc2);
+							acc3 = _mm256_fmadd_ps(w, _mm256_loadu_ps(in + 3 * n + j), acc3);
+						}
+
+						float r0 = hsum_avx2(acc0), r1 = hsum_avx2(acc1), r2 = hsum_avx2(acc2), r3 = hsum_avx2(acc3);
+
+						for (; j < n; ++j) {
+							r0 += row[j] * in[j];
+							r1 += row[j] * in[n + j];
+							r2 += row[j] * in[2 * n + j];
+							r3 += row[j] * in[3 * n + j];
+						}
+
+						out[i] = r0 - bias;
+						out[count + i] = r1 - bias;
+						out[2 * count + i] = r2 - bias;
+						out[3 * count + i] = r3 - bias;
+					}
+				}
+
+				for (; r < rows; ++r) {
+					layer_avx2(weights, stride, biases, biasStride, count, n, inputs + r * n, outputs + r * count);
+				}
+			}
+
+			__attribute__((target("avx2,fma")))
+			inline void sigmoid_avx2(float *values, std::size_t size) {
+				const __m256 one = _mm256_set1_ps(1.0f);
+
+				std::size_t i = 0;
+
+				for (; i + 8 <= size; i += 8) {
+					const __m256 x = _mm256_loadu_ps(values + i);
+					_mm256_storeu_ps(values + i, _mm256_div_ps(one, _mm256_add_ps(one, exp_avx2(_mm256_sub_ps(_mm256_setzero_ps(), x)))));
+				}
+
+				sigmoid_sse2(values + i, size - i);
+			}
+
+			__attribute__((target("avx2,fma")))
+			inline void clamp_avx2(float *values, std::size_t size, float lo, float hi) {
+				const __m256 low = _mm256_set1_ps(lo), high = _mm256_set1_ps(hi);
+
+				std::size_t i = 0;
+
+				for (; i + 8 <= size; i += 8) {
+					_mm256_storeu_ps(values + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(values + i), low), high));
+				}
+
+				clamp_sse2(values + i, size - i, lo, hi);
+			}
+
+			__attribute__((target("avx2,fma")))
+			inline __m256i load_i8_avx2(const std::int8_t *p) {
+				return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+			}
+
+			// 4 rows per pass share each sign extended block of 16 inputs
+			__attribute__((target("avx2,fma")))
+			inline void layer_i8_avx2(const std::int8_t *weights, std::size_t stride, std::size_t count, std::size_t n, const std::int8_t *inputs, std::int32_t *outputs) {
+				const std::size_t blocked = n / 16 * 16;
+
+				std::size_t i = 0;
+
+				for (; i + 4 <= count; i += 4) {
+					const std::int8_t *w0 = weights + i * stride, *w1 = w0 + stride, *w2 = w1 + stride, *w3 = w2 + stride;
+
+					__m256i acc0 = _mm256_setzero_si256(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+					for (std::size_t j = 0; j < blocked; j += 16) {
+						const __m256i x = load_i8_avx2(inputs + j);
+
+						acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(load_i8_avx2(w0 + j), x));
+						acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(load_i8_avx2(w1 + j), x));
+						acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(load_i8_avx2(w2 + j), x));
+						acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(load_i8_avx2(w3 + j), x));
+					}
+
+					// lane k of the result is the sum of acc k
+					const __m256i sums = _mm256_hadd_epi32(_mm256_hadd_epi32(acc0, acc1), _mm256_hadd_epi32(acc2, acc3));
+					const __m128i result = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(outputs + i), result);
+
+					if (blocked < n) {
+						outputs[i] += dot_i8_scalar(w0 + blocked, inputs + blocked, n - blocked);
+						outputs[i + 1] += dot_i8_scalar(w1 + blocked, inputs + blocked, n - blocked);
+						outputs[i + 2] += dot_i8_scalar(w2 + blocked, inputs + blocked, n - blocked);
+						outputs[i + 3] += dot_i8_scalar(w3 + blocked, inputs + blocked, n - blocked);
+					}
+				}
+
+				layer_i8_sse2(weights + i * stride, stride, count - i, n, inputs, outputs + i);
+			}
+
+			// AVX-512F, tails use masked loads instead of scalar loops.
+			// gcc's avx512 headers trip -Wmaybe-uninitialized on _mm512_undefined_ps.
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+	#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+			__attribute__((target("avx512f")))
+			inline __mmask16 tail_mask_avx512(std::size_t remaining) {
+				return remaining >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << remaining) - 1);
+			}
+
+			__attribute__((target("avx512f")))
+			inline __m512 exp_avx512(__m512 x) {
+				x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(expMin)), _mm512_set1_ps(expMax));
+
+				const __m512 fn = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+				x = _mm512_fnmadd_ps(fn, _mm512_set1_ps(ln2Hi), x);
+				x = _mm512_fnmadd_ps(fn, _mm512_set1_ps(ln2Lo), x);
+
+				__m512 p = _mm512_set1_ps(expP0);
+				p = _mm512_fmadd_ps(p, x, _mm512_set1_ps(expP1));
+				p = _mm512_fmadd_ps(p, x, _mm512_set1_ps(expP2));
+				p = _mm512_fmadd_ps(p, x, _mm512_set1_ps(expP3));
+				p = _mm512_fmadd_ps(p, x, _mm512_set1_ps(expP4));
+				p = _mm512_fmadd_ps(p, x, _mm512_set1_ps(expP5));
+				p = _mm512_fmadd_ps(p, _mm512_mul_ps(x, x), _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+
+				return _mm512_scalef_ps(p, fn);
+			}
+
+			__attribute__((target("avx512f")))
+			inline float dot_avx512(const float *a, const float *b, std::size_t n) {
+				__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+
+				std::size_t j = 0;
+
+				for (; j + 32 <= n; j += 32) {
+					acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j), acc0);
+					acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j + 16), _mm512_loadu_ps(b + j + 16), acc1);
+				}
+
+				for (; j < n; j += 16) {
+					const __mmask16 mask = tail_mask_avx512(n - j);
+					acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + j), _mm512_maskz_loadu_ps(mask, b + j), acc0);
+				}
+
+				return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+			}
+
+			__attribute__((target("avx512f")))
+			inline void layer_avx512(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs) {
+				// a single partial zmm per row loses to ymm on the reductions
+				if (n < 16) {
+					return layer_avx2(weights, stride, biases, biasStride, count, n, inputs, outputs);
+				}
+
+				std::size_t i = 0;
+
+				for (; i + 4 <= count; i += 4) {
+					const float *w0 = weights + i * stride, *w1 = w0 + stride, *w2 = w1 + stride, *w3 = w2 + stride;
+
+					__m512 acc0 = _mm512_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+					for (std::size_t j = 0; j < n; j += 16) {
+						const __mmask16 mask = tail_mask_avx512(n - j);
+						const __m512 x = _mm512_maskz_loadu_ps(mask, inputs + j);
+
+						acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, w0 + j), x, acc0);
+						acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, w1 + j), x, acc1);
+						acc2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, w2 + j), x, acc2);
+						acc3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, w3 + j), x, acc3);
+					}
+
+					outputs[i] = _mm512_reduce_add_ps(acc0) - biases[i * biasStride];
+					outputs[i + 1] = _mm512_reduce_add_ps(acc1) - biases[(i + 1) * biasStride];
+					outputs[i + 2] = _mm512_reduce_add_ps(acc2) - biases[(i + 2) * biasStride];
+					outputs[i + 3] = _mm512_reduce_add_ps(acc3) - biases[(i + 3) * biasStride];
+				}
+
+				for (; i < count; ++i) {
+					outputs[i] = dot_avx512(weights + i * stride, inputs, n) - biases[i * biasStride];
+				}
+			}
+
+			__attribute__((target("avx512f")))
+			inline void layer_batch_avx512(const float *weights, std::size_t stride, const float *biases, std::size_t biasStride, std::size_t count, std::size_t n, const float *inputs, float *outputs, std::size_t rows) {
+				if (n < 16) {
+					return layer_batch_avx2(weights, stride, biases, biasStride, count, n, inputs, outputs, rows);
+				}
+
+				std::size_t r = 0;
+
+				for (; r + 4 <= rows; r += 4) {
+					const float *in = inputs + r * n;
+					float *out = outputs + r * count;
+
+					for (std::size_t i = 0; i < count; ++i) {
+						const float *row = weights + i * stride;
+						const float bias = biases[i * biasStride];
+
+						__m512 acc0 = _mm512_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+						for (std::size_t j = 0; j < n; j += 16) {
+							const __mmask16 mask = tail_mask_avx512(n - j);
+							const __m512 w = _mm512_maskz_loadu_ps(mask, row + j);
+
+							acc0 = _mm512_fmadd_ps(w, _mm512_maskz_loadu_ps(mask, in + j), acc0);
+							acc1 = _mm512_fmadd_ps(w, _mm512_maskz_loadu_ps(mask, in + n + j), acc1);
+							acc2 = _mm512_fmadd_ps(w, _mm512_maskz_loadu_ps(mask, in + 2 * n + j), acc2);
+							acc3 = _mm512_fmadd_ps(w, _mm512_maskz_loadu_ps(mask, in + 3 * n + j), acc3);
+						}
+
+						out[i] = _mm512_reduce_add_ps(acc0) - bias;
+						out[count + i] = _mm512_reduce_add_ps(acc1) - bias;
+						out[2 * count + i] = _mm512_reduce_add_ps(acc2) - bias;
+						out[3 * count + i] = _mm512_reduce_add_ps(acc3) - bias;
+					}
+				}
+
+				for (; r < rows; ++r) {
+					layer_avx512(weights, stride, biases, biasStride, count, n, inputs + r * n, outputs + r * count);
+				}
+			}
+
+			__attribute__((target("avx512f")))
+			inline void sigmoid_avx512(float *values, std::size_t size) {
+				if (size < 16) {
+					return sigmoid_avx2(values, size);
+				}
+
+				const __m512 one = _mm512_set1_ps(1.0f);
+
+				for (std::size_t i = 0; i < size; i += 16) {
+					const __mmask16 mask = tail_mask_avx512(size - i);
+					const __m512 x = _mm512_maskz_loadu_ps(mask, values + i);
+					_mm512_mask_storeu_ps(values + i, mask, _mm512_div_ps(one, _mm512_add_ps(one, exp_avx512(_mm512_sub_ps(_mm512_setzero_ps(), x)))));
+				}
+			}
+
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic pop
+#endif
+#endif
+
+			inline Kernels make_kernels(Isa isa) {
+				switch (isa) {
+#ifdef NEURALNET_SIMD_X86
+				// byte and word multiplies need AVX-512BW, so AVX-512F keeps the AVX2 integer kernels
+				case AVX512: return Kernels{AVX512, layer_avx512, layer_batch_avx512, sigmoid_avx512, clamp_avx2, layer_i8_avx2};
+				case AVX2: return Kernels{AVX2, layer_avx2, layer_batch_avx2, sigmoid_avx2, clamp_avx2, layer_i8_avx2};
+				case SSE2: return Kernels{SSE2, layer_sse2, layer_batch_sse2, sigmoid_sse2, clamp_sse2, layer_i8_sse2};
+#endif
+				default: return Kernels{Scalar, layer_scalar, layer_batch_scalar, sigmoid_scalar, clamp_scalar, layer_i8_scalar};
+				}
+			}
+
+			inline Isa detect() {
+#ifdef NEURALNET_SIMD_X86
+				__builtin_cpu_init();
+
+				if (__builtin_cpu_supports("avx512f")) {
+					return AVX512;
+				}
+
+				if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+					return AVX2;
+				}
+
+				if (__builtin_cpu_supports("sse2")) {
+					return SSE2;
+				}
+#endif
+				return Scalar;
+			}
+
+			inline Kernels &active() {
+				static Kernels kernels = make_kernels(detect());
+				return kernels;
+			}
+		}
+
+		inline bool supported(Isa isa) {
+			return isa <= detail::detect();
+		}
+
+		// the kernels picked at startup
+		inline const Kernels &kernels() {
+			return detail::active();
+		}
+
+		// overrides the startup choice, e.g. to compare kernels. not thread safe, call before any calculate.
+		inline bool select(Isa isa) {
+			if (!supported(isa)) {
+				return false;
+			}
+
+			detail::active() = detail::make_kernels(isa);
+
+			return true;
+		}
+	}
+}
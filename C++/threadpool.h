@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace neuralnet
+{
+	// persistent worker threads with one task deque each, for loops whose iterations take very different times
+	// (e.g. games of any length). for_each splits a loop into chunks dealt round robin over the deques; a worker
+	// runs its own chunks from the front, in submission order, and when it runs out steals from the back of the others.
+	// the calling thread works too, and only waits for its own loop: workers that finish early go straight to
+	// whatever is submitted next instead of meeting at a barrier, and no threads are started per loop.
+	struct ThreadPool
+	{
+		// numThreads counts the calling thread, so 1 runs everything on the caller
+		explicit ThreadPool(std::size_t numThreads = std::thread::hardware_concurrency()) :
+			queues(numThreads > 1 ? numThreads - 1 : 1),
+			queued(0),
+			stopping(false)
+		{
+			for (std::size_t i = 0; i + 1 < numThreads; ++i) {
+				workers.emplace_back([this, i]() {
+					work(i);
+				});
+			}
+		}
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				stopping = true;
+			}
+
+			wake.notify_all();
+
+			for (std::thread &worker : workers) {
+				worker.join();
+			}
+		}
+
+		// threads running loops, including the caller
+		std::size_t size() const {
+			return workers.size() + 1;
+		}
+
+		// func(i) for every i in [0, count), chunkSize indices per task. returns once all have run
+		template <class Func>
+		void for_each(std::size_t count, std::size_t chunkSize, Func func) {
+			if (count == 0) {
+				return;
+			}
+
+			chunkSize = chunkSize > 0 ? chunkSize : 1;
+
+			const std::size_t numChunks = (count + chunkSize - 1) / chunkSize;
+
+			Group group;
+
+			group.run = [](void *context, std::size_t i) {
+				(*static_cast<Func *>(context))(i);
+			};
+			group.context = &func;
+			group.pending = numChunks;
+
+			if (workers.empty()) {
+				for (std::size_t i = 0; i < count; ++i) {
+					func(i);
+				}
+
+				return;
+			}
+
+			// counted before they can be taken, so queued never drops below the tasks in the queues
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				queued += numChunks;
+			}
+
+			for (std::size_t q = 0; q < queues.size(); ++q) {
+				std::lock_guard<std::mutex> lock(queues[q].mutex);
+
+				for (std::size_t c = q; c < numChunks; c += queues.size()) {
+					const std::size_t begin = c * chunkSize;
+					queues[q].tasks.push_back(Task{&group, begin, begin + chunkSize < count ? begin + chunkSize : count});
+				}
+			}
+
+			wake.notify_all();
+
+			// help, any task will do, until the last of ours is finished
+			std::size_t next = 0;
+
+			while (group.pending.load(std::memory_order_acquire) > 0) {
+				Task task;
+
+				if (take(next, task)) {
+					execute(task);
+				} else {
+					std::this_thread::yield();
+				}
+
+				next = next + 1 < queues.size() ? next + 1 : 0;
+			}
+		}
+
+	private:
+		struct Group
+		{
+			void (*run)(void *context, std::size_t i);
+			void *context;
+			std::atomic<std::size_t> pending; // chunks not finished
+		};
+
+		struct Task
+		{
+			Group *group;
+			std::size_t begin, end;
+		};
+
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		static void execute(const Task &task) {
+			for (std::size_t i = task.begin; i < task.end; ++i) {
+				task.group->run(task.group->context, i);
+			}
+
+			task.group->pending.fetch_sub(1, std::memory_order_acq_rel);
+		}
+
+		// the front of queue home, else the back of another
+		bool take(std::size_t home, Task &task) {
+			for (std::size_t k = 0; k < queues.size(); ++k) {
+				Queue &queue = queues[(home + k) % queues.size()];
+
+				std::lock_guard<std::mutex> lock(queue.mutex);
+
+				if (!queue.tasks.empty()) {
+					if (k == 0) {
+						task = queue.tasks.front();
+						queue.tasks.pop_front();
+					} else {
+						task = queue.tasks.back();
+						queue.tasks.pop_back();
+					}
+
+					--queued;
+
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void work(std::size_t home) {
+			for (;;) {
+				Task task;
+
+				if (take(home, task)) {
+					execute(task);
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(sleepMutex);
+
+				wake.wait(lock, [this]() {
+					return stopping || queued.load() > 0;
+				});
+
+				if (stopping) {
+					return;
+				}
+			}
+		}
+
+		std::vector<Queue> queues;
+		std::vector<std::thread> workers;
+		std::atomic<std::size_t> queued; // tasks in all queues
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+		bool stopping;
+	};
+}
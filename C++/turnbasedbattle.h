@@ -1,13 +1,41 @@
 #pragma once
 
-#include <type_traits>
-#include <functional>
 #include <algorithm>
-#include <string>
+#include <cstddef>
+#include <limits>
+#include <vector>
 
 namespace turnbasedbattle
 {
-	struct Action;
+	struct Player;
+
+	typedef const Player &PlayerConstRef;
+	typedef Player &PlayerRef;
+
+	// actions are plain data in a constexpr table, dispatched by id. name and description are only for display.
+	struct Action
+	{
+		enum Id {
+			Block,
+			Meditate,
+			Heal,
+			MinorDamage,
+			MajorDamage,
+			Reflect,
+			Absorb,
+			Reverse,
+			Copy,
+			None // action_none, not part of actions
+		};
+
+		Id id;
+		const char *name, *description;
+		float cost; // energy, spells with a cost require that much energy
+		float amount; // energy, health or damage, depending on the action
+
+		bool predicate(PlayerConstRef caster, PlayerConstRef target) const;
+		void perform(PlayerRef caster, PlayerRef target) const;
+	};
 
 	struct Player
 	{
@@ -16,154 +44,91 @@ namespace turnbasedbattle
 		const Action *lastAction;
 	};
 
-	typedef const Player &PlayerConstRef;
-	typedef Player &PlayerRef;
-
-	struct Action
-	{
-		std::string name, description;
-		std::function<bool(PlayerConstRef caster, PlayerConstRef target)> predicate;
-		std::function<void(PlayerRef caster, PlayerRef target)> perform;
+	constexpr Action action_none{Action::None, "None", "Internal default action", 0.0f, 0.0f};
+
+	constexpr Action actions[] = {
+		{Action::Block, "Block", "Reduce damage by 33%", 0.0f, 0.0f},
+		{Action::Meditate, "Meditate", "Gain 0.0625 energy", 0.0f, 0.0625f},
+		{Action::Heal, "Heal", "Gain 0.09375 health (energy cost: 0.125000)", 0.125f, 0.09375f},
+		{Action::MinorDamage, "Minor Damage", "Deal 0.125 damage (energy cost: 0.125000)", 0.125f, 0.125f},
+		{Action::MajorDamage, "Major Damage", "Deal 0.25 damage (energy cost: 0.250000)", 0.25f, 0.25f},
+		{Action::Reflect, "Reflect", "Reflect damage back to enemy (energy cost: 0.125000)", 0.125f, 0.0f},
+		{Action::Absorb, "Absorb", "Absorb damage as energy (energy cost: 0.125000)", 0.125f, 0.0f},
+		{Action::Reverse, "Reverse", "Reverse damage as health (energy cost: 0.125000)", 0.125f, 0.0f},
+		{Action::Copy, "Copy", "Copy enemy's spell (energy cost: 0.125000)", 0.125f, 0.0f},
 	};
 
-	const Action action_none{
-		"None",
-		"Internal default action",
-		[](PlayerConstRef caster, PlayerConstRef target) {return true;},
-		[](PlayerRef caster, PlayerRef target) {}
-	};
+	constexpr bool actions_indexed_by_id(std::size_t i = 0) {
+		return i == sizeof(actions) / sizeof(actions[0]) || (actions[i].id == static_cast<Action::Id>(i) && actions_indexed_by_id(i + 1));
+	}
+
+	static_assert(actions_indexed_by_id(), "actions must be ordered by Action::Id");
 
-	void heal(PlayerRef target, float amount) {
+	inline void heal(PlayerRef target, float amount) {
 		target.health = std::min(target.health + amount, 1.0f);
 	}
 
-	void battery(PlayerRef target, float amount) {
+	inline void battery(PlayerRef target, float amount) {
 		target.energy = std::min(target.energy + amount, 1.0f);
 	}
 
-	void apply_damage(PlayerRef caster, PlayerRef target, float amount) {
-		if (target.lastAction->name == "Block") {
+	inline void apply_damage(PlayerRef caster, PlayerRef target, float amount) {
+		switch (target.lastAction->id) {
+		case Action::Block:
 			amount *= 0.666666666666f;
-		} else if (target.lastAction->name == "Reflect") {
+			break;
+		case Action::Reflect:
 			caster.health -= amount;
-
 			return;
-		} else if (target.lastAction->name == "Absorb") {
+		case Action::Absorb:
 			battery(target, amount / 2);
-
 			return;
-		} else if (target.lastAction->name == "Reverse") {
+		case Action::Reverse:
 			heal(target, amount / 2);
-
 			return;
+		default:
+			break;
 		}
 
 		target.health -= amount;
 	}
 
-	template <class Predicate, class Perform>
-	Action make_energy_cost_spell(const std::string &name, std::string description, float cost, Predicate predicate, Perform perform) {
-		description += std::string(" (energy cost: ");
-		description += std::to_string(cost);
-		description += ')';
-
-		return Action{
-			name,
-			description,
-			[cost, predicate](PlayerConstRef caster, PlayerConstRef target) {
-				return caster.energy >= cost && predicate(caster, target);
-			},
-			[cost, perform](PlayerRef caster, PlayerRef target) {
-				caster.energy -= cost;
-				perform(caster, target);
-			}
-		};
-	}
+	// no action depends on the target yet
+	inline bool Action::predicate(PlayerConstRef caster, PlayerConstRef) const {
+		if (cost > 0 && caster.energy < cost) {
+			return false;
+		}
 
-	template <class Perform>
-	Action make_energy_cost_spell(const std::string &name, const std::string &description, float cost, Perform perform) {
-		return make_energy_cost_spell(
-			name,
-			description,
-			cost,
-			[](PlayerConstRef caster, PlayerConstRef target) {return true;},
-			perform
-		);
+		switch (id) {
+		case Meditate: return caster.energy < 1.0f;
+		case Heal: return caster.health < 1.0f;
+		default: return true;
+		}
 	}
 
-	const Action actions[] = {
-		Action{
-			"Block",
-			"Reduce damage by 33%",
-			[](PlayerConstRef caster, PlayerConstRef target) {return true;},
-			[](PlayerRef caster, PlayerRef target) {}
-		},
-		Action{
-			"Meditate",
-			"Gain 0.0625 energy",
-			[](PlayerConstRef caster, PlayerConstRef target) {
-				return caster.energy < 1.0f;
-			},
-			[](PlayerRef caster, PlayerRef target) {
-				battery(caster, 0.0625f);
-			}
-		},
-		make_energy_cost_spell(
-			"Heal",
-			"Gain 0.09375 health",
-			0.125f,
-			[](PlayerConstRef caster, PlayerConstRef target) {
-				return caster.health < 1.0f;
-			},
-			[](PlayerRef caster, PlayerRef target) {
-				heal(caster, 0.09375f);
-			}
-		),
-		make_energy_cost_spell(
-			"Minor Damage",
-			"Deal 0.125 damage",
-			0.125f,
-			[](PlayerRef caster, PlayerRef target) {
-				apply_damage(caster, target, 0.125f);
-			}
-		),
-		make_energy_cost_spell(
-			"Major Damage",
-			"Deal 0.25 damage",
-			0.25f,
-			[](PlayerRef caster, PlayerRef target) {
-				apply_damage(caster, target, 0.25f);
-			}
-		),
-		make_energy_cost_spell(
-			"Reflect",
-			"Reflect damage back to enemy",
-			0.125f,
-			[](PlayerRef caster, PlayerRef target) {}
-		),
-		make_energy_cost_spell(
-			"Absorb",
-			"Absorb damage as energy",
-			0.125f,
-			[](PlayerRef caster, PlayerRef target) {}
-		),
-		make_energy_cost_spell(
-			"Reverse",
-			"Reverse damage as health",
-			0.125f,
-			[](PlayerRef caster, PlayerRef target) {}
-		),
-		make_energy_cost_spell(
-			"Copy",
-			"Copy enemy's spell",
-			0.125f,
-			[](PlayerRef caster, PlayerRef target) {
-				if (target.lastAction->name != "Copy") {
-					target.lastAction->perform(caster, target);
-				}
+	inline void Action::perform(PlayerRef caster, PlayerRef target) const {
+		caster.energy -= cost;
+
+		switch (id) {
+		case Meditate:
+			battery(caster, amount);
+			break;
+		case Heal:
+			heal(caster, amount);
+			break;
+		case MinorDamage:
+		case MajorDamage:
+			apply_damage(caster, target, amount);
+			break;
+		case Copy:
+			if (target.lastAction->id != Copy) {
+				target.lastAction->perform(caster, target);
 			}
-		),
-	};
+			break;
+		default:
+			break;
+		}
+	}
 
 	template <class T, std::size_t size>
 	constexpr std::size_t array_size(const T(&)[size]) {
@@ -233,6 +198,45 @@ namespace turnbasedbattle
 			return numMoves;
 		}
 
+		// plays count games in lock step with the same rules as automate. each move, an actor is called once
+		// with every live game: actor(games, indices, n, playerNum, actions) sets actions[k] for games[indices[k]],
+		// k < n, which lets a net evaluate all live games as one batch. games retire as they finish.
+		template <class Actor1, class Actor2>
+		static void automate_batch(Game *games, std::size_t count, Actor1 actor1, Actor2 actor2, int maxMoves, int *numMoves) {
+			std::vector<std::size_t> live(count), next;
+			std::vector<const Action *> actions1(count), actions2(count);
+
+			for (std::size_t i = 0; i < count; ++i) {
+				games[i].reset();
+				live[i] = i;
+				numMoves[i] = 0;
+			}
+
+			next.reserve(count);
+
+			const Game *const_games = games;
+
+			while (!live.empty()) {
+				actor1(const_games, live.data(), live.size(), 0, actions1.data());
+				actor2(const_games, live.data(), live.size(), 1, actions2.data());
+
+				next.clear();
+
+				for (std::size_t k = 0; k < live.size(); ++k) {
+					const std::size_t i = live[k];
+
+					games[i].move(*actions1[k], *actions2[k]);
+					++numMoves[i];
+
+					if (games[i].is_game_on() && numMoves[i] < maxMoves) {
+						next.push_back(i);
+					}
+				}
+
+				live.swap(next);
+			}
+		}
+
 		Player players[2];
 	};
 }